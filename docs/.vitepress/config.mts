@@ -75,6 +75,7 @@ export default defineConfig({
 						{ text: "Methods", link: "/api/methods" },
 						{ text: "Unit Enum", link: "/api/units" },
 						{ text: "Constants", link: "/api/constants" },
+						{ text: "Filters", link: "/api/filters" },
 					],
 				},
 			],
@@ -99,6 +100,7 @@ export default defineConfig({
 						{ text: "Unit Conversions", link: "/technical/conversions" },
 						{ text: "Performance", link: "/technical/performance" },
 						{ text: "Compatibility", link: "/technical/compatibility" },
+						{ text: "Host Testing", link: "/technical/testing" },
 					],
 				},
 			],
@@ -2,7 +2,7 @@
  * Advanced Usage Example - MinimalUltrasonic
  *
  * Demonstrates:
- * - Median filtering for stability
+ * - Streaming median filtering for stability
  * - Error handling and recovery
  * - Performance monitoring
  * - State management
@@ -10,6 +10,7 @@
  */
 
 #include <MinimalUltrasonic.h>
+#include <MinimalUltrasonicFilters.h>
 
 // Configuration
 const uint8_t TRIG_PIN = 12;
@@ -39,7 +40,9 @@ enum State
 State currentState = STATE_UNKNOWN;
 State previousState = STATE_UNKNOWN;
 
-// Statistics
+// Statistics of the distances seen. For ping health (timeouts by cause,
+// blocking time) build with -DMINIMAL_ULTRASONIC_STATS=1 and use
+// sensor.getStats() instead of counting in the sketch.
 struct Statistics
 {
   unsigned long totalReadings;
@@ -55,85 +58,39 @@ Statistics stats = {0, 0, 0, 999999.0, 0, 0, 0};
 
 // Filtering
 const int FILTER_SIZE = 5;
-float filterBuffer[FILTER_SIZE];
-int filterIndex = 0;
-bool filterFilled = false;
+
+// Streaming median over the last 5 pings: one ping per call, no bursts
+UltrasonicMedianFilter<FILTER_SIZE> median;
+
+// The filter skips failed pings, so forget the target after this many
+// failures in a row instead of repeating its last median forever
+const int MAX_MISSES = 3;
+int misses = 0;
 
 /**
  * Get median filtered distance
  */
 float getMedianDistance()
 {
-  float readings[FILTER_SIZE];
-  int validCount = 0;
+  MinimalUltrasonic::Reading reading = median.update(sensor.measure());
 
-  // Collect readings
-  for (int i = 0; i < FILTER_SIZE; i++)
+  if (reading.ok())
   {
-    float dist = sensor.read();
-
-    if (dist > 0)
-    {
-      readings[validCount++] = dist;
-    }
-
-    delay(20);
+    misses = 0;
   }
-
-  // Need at least 3 valid readings
-  if (validCount < 3)
+  else if (++misses >= MAX_MISSES)
   {
+    median.reset();
     return 0;
   }
 
-  // Sort readings (bubble sort)
-  for (int i = 0; i < validCount - 1; i++)
-  {
-    for (int j = i + 1; j < validCount; j++)
-    {
-      if (readings[i] > readings[j])
-      {
-        float temp = readings[i];
-        readings[i] = readings[j];
-        readings[j] = temp;
-      }
-    }
-  }
-
-  // Return median
-  return readings[validCount / 2];
-}
-
-/**
- * Get moving average distance
- */
-float getMovingAverage()
-{
-  float distance = sensor.read();
-
-  if (distance > 0)
+  // Need at least 3 valid readings
+  if (median.count() < 3)
   {
-    filterBuffer[filterIndex] = distance;
-    filterIndex = (filterIndex + 1) % FILTER_SIZE;
-
-    if (filterIndex == 0)
-    {
-      filterFilled = true;
-    }
-  }
-
-  // Calculate average
-  int count = filterFilled ? FILTER_SIZE : filterIndex;
-  if (count == 0)
     return 0;
-
-  float sum = 0;
-  for (int i = 0; i < count; i++)
-  {
-    sum += filterBuffer[i];
   }
 
-  return sum / count;
+  return median.distance();
 }
 
 /**
@@ -292,6 +249,30 @@ void printStatistics()
   Serial.println();
 }
 
+/**
+ * Get measurement status name
+ */
+const char *getStatusName(MinimalUltrasonic::Status status)
+{
+  switch (status)
+  {
+  case MinimalUltrasonic::OK:
+    return "OK";
+  case MinimalUltrasonic::NO_ECHO:
+    return "no echo";
+  case MinimalUltrasonic::STUCK_HIGH:
+    return "echo stuck high";
+  case MinimalUltrasonic::OUT_OF_GATE:
+    return "out of range";
+  case MinimalUltrasonic::TOO_SOON:
+    return "too soon";
+  case MinimalUltrasonic::NO_CONSENSUS:
+    return "no consensus";
+  default:
+    return "unknown";
+  }
+}
+
 /**
  * Diagnostic check
  */
@@ -338,22 +319,23 @@ void runDiagnostics()
 
   for (int i = 0; i < 10; i++)
   {
-    float dist = sensor.read();
+    MinimalUltrasonic::Reading reading = sensor.measure();
 
     Serial.print("  ");
     Serial.print(i + 1);
     Serial.print(". ");
 
-    if (dist > 0)
+    if (reading.ok())
     {
       Serial.print("✓ ");
-      Serial.print(dist, 1);
+      Serial.print(reading.distance(), 1);
       Serial.println(" cm");
       successCount++;
     }
     else
     {
-      Serial.println("✗ Error");
+      Serial.print("✗ Error: ");
+      Serial.println(getStatusName(reading.status));
     }
 
     delay(100);
@@ -393,6 +375,9 @@ void setup()
   sensor.setUnit(MinimalUltrasonic::CM);
   sensor.setTimeout(20000UL);
 
+  // For a cheaper moving average instead of the median, the sensor can
+  // smooth every reading itself: sensor.setSmoothing(2);  // alpha = 1/4
+
   // Run diagnostics
   runDiagnostics();
 
@@ -446,5 +431,6 @@ void loop()
     }
   }
 
-  delay(500);
+  // The median updates on every ping, so the loop can run at full rate
+  delay(100);
 }
\ No newline at end of file
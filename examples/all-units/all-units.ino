@@ -9,6 +9,9 @@
  * - Yards (YARDS)
  * - Miles (MILES)
  *
+ * All values come from a single ping via readAll(), so they describe
+ * the same instant.
+ *
  * Hardware:
  * - HC-SR04 Ultrasonic Sensor
  * - Arduino Uno or compatible
@@ -32,51 +35,46 @@ void loop()
   Serial.println("Measuring distance in all units:");
   Serial.println("----------------------------------");
 
+  // One ping, converted to every unit
+  MinimalUltrasonic::Distances distances;
+  MinimalUltrasonic::Reading reading = sensor.readAll(distances);
+
+  if (!reading.ok())
+  {
+    Serial.println("No valid echo");
+    Serial.println();
+    delay(2000);
+    return;
+  }
+
   // Centimeters (default)
-  sensor.setUnit(MinimalUltrasonic::CM);
-  float cm = sensor.read();
   Serial.print("Centimeters:  ");
-  Serial.print(cm, 2);
+  Serial.print(distances[MinimalUltrasonic::CM], 2);
   Serial.println(" cm");
-  delay(50);
 
   // Meters
-  sensor.setUnit(MinimalUltrasonic::METERS);
-  float meters = sensor.read();
   Serial.print("Meters:       ");
-  Serial.print(meters, 4);
+  Serial.print(distances[MinimalUltrasonic::METERS], 4);
   Serial.println(" m");
-  delay(50);
 
   // Millimeters
-  sensor.setUnit(MinimalUltrasonic::MM);
-  float mm = sensor.read();
   Serial.print("Millimeters:  ");
-  Serial.print(mm, 1);
+  Serial.print(distances[MinimalUltrasonic::MM], 1);
   Serial.println(" mm");
-  delay(50);
 
   // Inches
-  sensor.setUnit(MinimalUltrasonic::INCHES);
-  float inches = sensor.read();
   Serial.print("Inches:       ");
-  Serial.print(inches, 2);
+  Serial.print(distances[MinimalUltrasonic::INCHES], 2);
   Serial.println(" in");
-  delay(50);
 
   // Yards
-  sensor.setUnit(MinimalUltrasonic::YARDS);
-  float yards = sensor.read();
   Serial.print("Yards:        ");
-  Serial.print(yards, 4);
+  Serial.print(distances[MinimalUltrasonic::YARDS], 4);
   Serial.println(" yd");
-  delay(50);
 
   // Miles
-  sensor.setUnit(MinimalUltrasonic::MILES);
-  float miles = sensor.read();
   Serial.print("Miles:        ");
-  Serial.print(miles, 7);
+  Serial.print(distances[MinimalUltrasonic::MILES], 7);
   Serial.println(" mi");
 
   Serial.println("==================================");
@@ -84,4 +82,4 @@ void loop()
 
   // Wait before next cycle
   delay(2000);
-}
\ No newline at end of file
+}
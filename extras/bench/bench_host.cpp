@@ -0,0 +1,296 @@
+/*
+ * @file bench_host.cpp
+ * @brief Host microbenchmarks of the library's hot paths, reported as JSON
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @details Each benchmark runs its operation in a loop, doubling the
+ *          iteration count until one batch takes at least --min-time, then
+ *          keeps the fastest of five batches. Results go to stdout as JSON
+ *          (or to --json FILE) so runs of different library versions can
+ *          be compared; a readable table goes to stderr.
+ *
+ *          Host numbers rank code paths and catch regressions; they are not
+ *          AVR timings.
+ *
+ * @license MIT License
+ *
+ * @example
+ * ./bench_host --json bench.json
+ * ./bench_host --filter convertToUnit --min-time 0.5
+ */
+
+#include <EchoSimulator.h>
+#include <MinimalUltrasonic.h>
+#include <MinimalUltrasonicFilters.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifndef MINIMAL_ULTRASONIC_VERSION
+#define MINIMAL_ULTRASONIC_VERSION "unknown"
+#endif
+
+namespace
+{
+  struct Result
+  {
+    std::string name;
+    unsigned long long iterations;
+    double nsPerOp;
+  };
+
+  double minTime = 0.2;
+  const char *filter = nullptr;
+  std::vector<Result> results;
+
+  /**
+   * @brief Keep a value alive without costing more than a register move
+   */
+  template <typename T>
+  inline void keep(const T &value)
+  {
+    asm volatile("" : : "r,m"(value) : "memory");
+  }
+
+  /**
+   * @brief Echo durations cycled through by the benchmarks (2 cm to 4 m)
+   */
+  uint16_t durations[256];
+
+  template <typename Operation>
+  double timeBatch(Operation &operation, unsigned long long iterations)
+  {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned long long i = 0; i < iterations; i++)
+    {
+      operation(i);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  }
+
+  template <typename Operation>
+  void bench(const std::string &name, Operation operation)
+  {
+    if (filter && name.find(filter) == std::string::npos)
+    {
+      return;
+    }
+
+    unsigned long long iterations = 1;
+    while (timeBatch(operation, iterations) < minTime && iterations < (1ULL << 40))
+    {
+      iterations *= 2;
+    }
+
+    double best = 1e30;
+    for (int batch = 0; batch < 5; batch++)
+    {
+      double seconds = timeBatch(operation, iterations);
+      if (seconds < best)
+      {
+        best = seconds;
+      }
+    }
+
+    Result result = {name, iterations, best * 1e9 / iterations};
+    results.push_back(result);
+    fprintf(stderr, "%-40s %12.2f ns/op %14.0f ops/s\n", name.c_str(), result.nsPerOp, 1e9 / result.nsPerOp);
+  }
+
+  /**
+   * @brief Bubble-sort median from the v2.0.0 Advanced example
+   */
+  uint16_t bubbleMedian(uint16_t *values, uint8_t count)
+  {
+    uint16_t sorted[16];
+    for (uint8_t i = 0; i < count; i++)
+    {
+      sorted[i] = values[i];
+    }
+    for (uint8_t i = 0; i < count - 1; i++)
+    {
+      for (uint8_t j = i + 1; j < count; j++)
+      {
+        if (sorted[i] > sorted[j])
+        {
+          uint16_t swap = sorted[i];
+          sorted[i] = sorted[j];
+          sorted[j] = swap;
+        }
+      }
+    }
+    return sorted[count / 2];
+  }
+
+  MinimalUltrasonic::Reading okReading(unsigned long i)
+  {
+    MinimalUltrasonic::Reading reading = {(uint32_t)(i * 60000UL), durations[i & 0xFF], MinimalUltrasonic::OK, 255};
+    return reading;
+  }
+
+  void writeJson(FILE *out)
+  {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"library\": \"MinimalUltrasonic\",\n");
+    fprintf(out, "  \"version\": \"%s\",\n", MINIMAL_ULTRASONIC_VERSION);
+    fprintf(out, "  \"compiler\": \"%s\",\n", __VERSION__);
+    fprintf(out, "  \"min_time_s\": %g,\n", minTime);
+    fprintf(out, "  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+      fprintf(out, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"ops_per_s\": %.0f}%s\n",
+              results[i].name.c_str(), results[i].iterations, results[i].nsPerOp, 1e9 / results[i].nsPerOp,
+              (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const char *jsonPath = nullptr;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--min-time") && i + 1 < argc)
+    {
+      minTime = atof(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+    {
+      filter = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--json") && i + 1 < argc)
+    {
+      jsonPath = argv[++i];
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [--min-time SECONDS] [--filter SUBSTRING] [--json FILE]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  for (int i = 0; i < 256; i++)
+  {
+    durations[i] = (uint16_t)(117 + i * 91);
+  }
+
+  // ===========================
+  // Conversions
+  // ===========================
+
+  static const char *const unitNames[MinimalUltrasonic::UNIT_COUNT] = {"CM", "METERS", "MM", "INCHES", "YARDS", "MILES"};
+  for (uint8_t unit = 0; unit < MinimalUltrasonic::UNIT_COUNT; unit++)
+  {
+    bench(std::string("convertToUnit/") + unitNames[unit], [unit](unsigned long i) {
+      keep(okReading(i).distance((MinimalUltrasonic::Unit)unit));
+    });
+  }
+
+  bench("readMicrometers/fixed_point", [](unsigned long i) { keep(okReading(i).micrometers()); });
+
+  bench("Threshold/construct", [](unsigned long i) {
+    keep(MinimalUltrasonic::Threshold(durations[i & 0xFF] / 58.2f).duration);
+  });
+
+  bench("closerThan/integer_compare", [](unsigned long i) {
+    static const MinimalUltrasonic::Threshold obstacle(30);
+    keep(okReading(i).closerThan(obstacle));
+  });
+
+  bench("closerThan/float_compare", [](unsigned long i) { keep(okReading(i).distance() < 30.0f); });
+
+  // ===========================
+  // Median of 3
+  // ===========================
+
+  bench("median3/min_max_network", [](unsigned long i) {
+    keep(MinimalUltrasonic::median3(durations[i & 0xFF], durations[(i * 7) & 0xFF], durations[(i * 13) & 0xFF]));
+  });
+
+  bench("median3/bubble_sort", [](unsigned long i) {
+    uint16_t values[3] = {durations[i & 0xFF], durations[(i * 7) & 0xFF], durations[(i * 13) & 0xFF]};
+    keep(bubbleMedian(values, 3));
+  });
+
+  // ===========================
+  // Filters
+  // ===========================
+
+  UltrasonicMedianFilter<5> median;
+  bench("UltrasonicMedianFilter<5>/update", [&median](unsigned long i) { keep(median.update(okReading(i))); });
+
+  UltrasonicHampelFilter<7> hampel;
+  bench("UltrasonicHampelFilter<7>/update", [&hampel](unsigned long i) { keep(hampel.update(okReading(i))); });
+
+  UltrasonicKalmanFilter kalman;
+  bench("UltrasonicKalmanFilter/update", [&kalman](unsigned long i) { keep(kalman.update(okReading(i))); });
+
+  UltrasonicCollisionEstimator<8> collision;
+  bench("UltrasonicCollisionEstimator<8>/update", [&collision](unsigned long i) {
+    keep(collision.update(okReading(i)));
+  });
+
+  // ===========================
+  // Full read() path
+  // ===========================
+
+  // Every poll of micros()/digitalRead() costs 1 virtual µs, so these
+  // include one loop iteration per microsecond of echo, as on a board.
+  {
+    hal::reset();
+    hal::scriptEcho(12, 13, 450, 1164);
+    MinimalUltrasonic sensor(12, 13);
+    bench("read/scripted_20cm", [&sensor](unsigned long) {
+      hal::advance(60000UL);
+      keep(sensor.read());
+    });
+  }
+
+  {
+    hal::reset();
+    EchoSimulator scene(1);
+    scene.addSensor(12, 13);
+    scene.addTarget(100);
+    scene.setNoise(8);
+    scene.setDropout(0.05);
+    MinimalUltrasonic sensor(12, 13);
+    bench("read/simulated_100cm", [&sensor](unsigned long) {
+      hal::advance(60000UL);
+      keep(sensor.read());
+    });
+  }
+
+  {
+    hal::reset();
+    hal::scriptEcho(12, 13, 450, 0);
+    MinimalUltrasonic sensor(12, 13);
+    bench("read/no_echo_timeout", [&sensor](unsigned long) {
+      hal::advance(60000UL);
+      keep(sensor.read());
+    });
+  }
+
+  FILE *out = stdout;
+  if (jsonPath)
+  {
+    out = fopen(jsonPath, "w");
+    if (!out)
+    {
+      perror(jsonPath);
+      return 1;
+    }
+  }
+  writeJson(out);
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+  return 0;
+}
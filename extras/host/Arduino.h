@@ -0,0 +1,54 @@
+/*
+ * @file Arduino.h
+ * @brief Minimal Arduino core API for building MinimalUltrasonic on a host
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @details Declares only what the library uses. The functions are backed by
+ *          the virtual clock and scripted pins in HostHal.cpp, so host builds
+ *          are deterministic and never sleep. Note that unsigned long is 64
+ *          bits on most hosts, not 32 as on AVR.
+ *
+ * @license MIT License
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+unsigned long micros(void);
+unsigned long millis(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/**
+ * @brief Text output, as the base of Serial; subclasses implement write()
+ */
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+
+  size_t print(char c);
+  size_t print(const char *text);
+  size_t print(unsigned long number);
+  size_t println();
+  size_t println(const char *text);
+  size_t println(unsigned long number);
+};
+
+#endif // Arduino_h
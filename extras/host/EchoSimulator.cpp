@@ -0,0 +1,192 @@
+/*
+ * @file EchoSimulator.cpp
+ * @brief Seedable acoustic scene that drives sensor echo pins on the host
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @license MIT License
+ */
+
+#include "EchoSimulator.h"
+
+#include <math.h>
+
+/**
+ * @brief Closest distance a sensor can report, in cm (HC-SR04 blind zone)
+ */
+static const float BLIND_ZONE_CM = 2.0f;
+
+/**
+ * @brief Distance at which an on-axis target of reflectivity 1 fades out, in cm
+ * Echo strength falls with the square of the distance.
+ */
+static const float RANGE_CM = 400.0f;
+
+const unsigned long EchoSimulator::NO_ECHO_WIDTH;
+const unsigned long EchoSimulator::BURST_DELAY;
+
+EchoSimulator::EchoSimulator(uint32_t seed)
+    : _state(seed ? seed : 1),
+      _jitter(0),
+      _dropout(0),
+      _multipath(0),
+      _crosstalk(0),
+      _speed(343.0f)
+{
+}
+
+EchoSimulator::~EchoSimulator()
+{
+  for (size_t i = 0; i < _sensors.size(); i++)
+  {
+    hal::onTrigger(_sensors[i].trigPin, nullptr);
+  }
+}
+
+uint8_t EchoSimulator::addSensor(uint8_t trigPin, uint8_t echoPin, float bearing, float halfAngle)
+{
+  Sensor sensor = {trigPin, echoPin, bearing, halfAngle, 0, 0, 0};
+  _sensors.push_back(sensor);
+  hal::onTrigger(trigPin, onTrigger, this);
+  return (uint8_t)(_sensors.size() - 1);
+}
+
+uint8_t EchoSimulator::addTarget(float distance, float velocity, float bearing, float reflectivity)
+{
+  Target target = {distance, velocity, bearing, reflectivity};
+  _targets.push_back(target);
+  return (uint8_t)(_targets.size() - 1);
+}
+
+float EchoSimulator::distanceAt(uint8_t target, unsigned long time) const
+{
+  const Target &t = _targets[target];
+  float distance = t.distance + t.velocity * (time / 1e6f);
+  return (distance > 0) ? distance : 0;
+}
+
+void EchoSimulator::onTrigger(uint8_t pin, unsigned long time, void *context)
+{
+  EchoSimulator &scene = *static_cast<EchoSimulator *>(context);
+  for (size_t i = 0; i < scene._sensors.size(); i++)
+  {
+    if (scene._sensors[i].trigPin == pin)
+    {
+      scene.fire(scene._sensors[i], time);
+      return;
+    }
+  }
+}
+
+void EchoSimulator::fire(Sensor &sensor, unsigned long time)
+{
+  // Still sending the previous echo: the module ignores the trigger
+  if (time < sensor.busyUntil)
+  {
+    return;
+  }
+
+  unsigned long rise = time + BURST_DELAY;
+  unsigned long fall = rise + NO_ECHO_WIDTH;
+
+  // The first echo that makes it back ends the pulse
+  for (size_t i = 0; i < _targets.size(); i++)
+  {
+    float distance = distanceAt((uint8_t)i, time);
+    if (!detectable(sensor, _targets[i], distance) || uniform() < _dropout)
+    {
+      continue;
+    }
+
+    float echo = (float)roundTrip(distance);
+    if (uniform() < _multipath)
+    {
+      echo *= 2;
+    }
+    echo += gaussian() * _jitter;
+
+    unsigned long arrival = rise + (unsigned long)((echo > 1) ? echo : 1);
+    if (arrival < fall)
+    {
+      fall = arrival;
+    }
+  }
+
+  // Echoes of other sensors' last pings still in flight
+  for (size_t s = 0; s < _sensors.size(); s++)
+  {
+    const Sensor &other = _sensors[s];
+    if (&other == &sensor || other.pings == 0)
+    {
+      continue;
+    }
+
+    for (size_t i = 0; i < _targets.size(); i++)
+    {
+      float distance = distanceAt((uint8_t)i, other.lastFire);
+      if (!detectable(other, _targets[i], distance) || !detectable(sensor, _targets[i], distance))
+      {
+        continue;
+      }
+
+      unsigned long arrival = other.lastFire + BURST_DELAY + roundTrip(distance);
+      if (arrival > rise && arrival < fall && uniform() < _crosstalk)
+      {
+        fall = arrival;
+      }
+    }
+  }
+
+  sensor.lastFire = time;
+  sensor.busyUntil = fall;
+  sensor.pings++;
+  hal::schedule(sensor.echoPin, rise, true);
+  hal::schedule(sensor.echoPin, fall, false);
+}
+
+bool EchoSimulator::detectable(const Sensor &sensor, const Target &target, float distance) const
+{
+  if (distance < BLIND_ZONE_CM)
+  {
+    return false;
+  }
+
+  float angle = fabsf(fmodf(target.bearing - sensor.bearing + 540.0f, 360.0f) - 180.0f);
+  if (angle > sensor.halfAngle)
+  {
+    return false;
+  }
+
+  // Half strength at the edge of the cone, inverse square with distance
+  float offAxis = angle / sensor.halfAngle;
+  float strength = target.reflectivity * (1.0f - 0.5f * offAxis * offAxis);
+  return strength * RANGE_CM * RANGE_CM >= distance * distance;
+}
+
+unsigned long EchoSimulator::roundTrip(float distance) const
+{
+  // 2 * distance (cm) / speed (m/s), in µs
+  return (unsigned long)(distance * 2e4f / _speed + 0.5f);
+}
+
+uint32_t EchoSimulator::next()
+{
+  // xorshift32: small, fast and identical on every platform
+  _state ^= _state << 13;
+  _state ^= _state >> 17;
+  _state ^= _state << 5;
+  return _state;
+}
+
+float EchoSimulator::uniform()
+{
+  return (next() >> 8) / 16777216.0f;
+}
+
+float EchoSimulator::gaussian()
+{
+  // Box-Muller; one draw per call keeps the sequence simple to reason about
+  float u = uniform();
+  float v = uniform();
+  return sqrtf(-2.0f * logf(u > 0 ? u : 1e-7f)) * cosf(6.2831853f * v);
+}
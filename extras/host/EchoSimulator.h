@@ -0,0 +1,165 @@
+/*
+ * @file EchoSimulator.h
+ * @brief Seedable acoustic scene that drives sensor echo pins on the host
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @details Models an HC-SR04-style sensor answering each trigger: the echo
+ *          pin rises after the burst and falls when the first detectable
+ *          echo returns, or after 38 ms when nothing answers. Targets move
+ *          at constant speed and reflect according to their reflectivity,
+ *          distance and angle off the sensor axis. Timing jitter, dropouts,
+ *          multipath ghosts and crosstalk from other sensors' pings are
+ *          drawn from one seeded generator, so a benchmark run with the same
+ *          seed and the same sequence of pings is identical every time.
+ *
+ *          All sensors sit at the origin and point along a bearing; a target
+ *          is seen by every sensor whose beam cone contains its bearing.
+ *
+ * @license MIT License
+ *
+ * @example
+ * hal::reset();
+ * EchoSimulator scene(42);
+ * scene.addSensor(12, 13);
+ * scene.addTarget(150, -20);  // 150 cm away, approaching at 20 cm/s
+ * scene.setNoise(8);
+ * scene.setDropout(0.05);
+ *
+ * MinimalUltrasonic sensor(12, 13);
+ * float cm = sensor.read();
+ */
+
+#ifndef EchoSimulator_h
+#define EchoSimulator_h
+
+#include "HostHal.h"
+
+#include <vector>
+
+class EchoSimulator
+{
+public:
+  /**
+   * @struct Target
+   * @brief A reflector moving radially at constant speed
+   */
+  struct Target
+  {
+    float distance;      ///< Distance at time 0 in cm
+    float velocity;      ///< Radial speed in cm/s (negative: approaching)
+    float bearing;       ///< Direction in degrees
+    float reflectivity;  ///< 1.0 for a flat wall, lower for soft or small objects
+  };
+
+  /**
+   * @brief Echo pin HIGH time when nothing answers (HC-SR04)
+   */
+  static const unsigned long NO_ECHO_WIDTH = 38000UL;
+
+  /**
+   * @brief Time from the end of the trigger to the echo pin rising
+   */
+  static const unsigned long BURST_DELAY = 450UL;
+
+  /**
+   * @brief Create an empty scene
+   * @param seed Seed of the random generator (any value)
+   */
+  explicit EchoSimulator(uint32_t seed = 1);
+
+  ~EchoSimulator();
+
+  // Registered with the HAL by address: not copyable
+  EchoSimulator(const EchoSimulator &) = delete;
+  EchoSimulator &operator=(const EchoSimulator &) = delete;
+
+  /**
+   * @brief Attach a sensor; its trigger pin is handled from now on
+   * @param trigPin Trigger pin
+   * @param echoPin Echo pin (the same pin for 3-pin sensors)
+   * @param bearing Direction the sensor points to, in degrees
+   * @param halfAngle Half-width of the beam cone in degrees (HC-SR04: ~15)
+   * @return Sensor index
+   */
+  uint8_t addSensor(uint8_t trigPin, uint8_t echoPin, float bearing = 0, float halfAngle = 15);
+
+  /**
+   * @brief Add a reflector to the scene
+   * @return Target index, for target()
+   */
+  uint8_t addTarget(float distance, float velocity = 0, float bearing = 0, float reflectivity = 1);
+
+  /**
+   * @brief Access a target to move it or change it between pings
+   */
+  Target &target(uint8_t index) { return _targets[index]; }
+
+  /**
+   * @brief Gaussian jitter of every echo, standard deviation in µs
+   */
+  void setNoise(float jitter) { _jitter = jitter; }
+
+  /**
+   * @brief Probability that a detectable echo is missed
+   */
+  void setDropout(float probability) { _dropout = probability; }
+
+  /**
+   * @brief Probability that an echo comes back via a second bounce (twice the distance)
+   */
+  void setMultipath(float probability) { _multipath = probability; }
+
+  /**
+   * @brief Probability that another sensor's echo, arriving while this one listens, ends its pulse
+   */
+  void setCrosstalk(float probability) { _crosstalk = probability; }
+
+  /**
+   * @brief Speed of sound used by the scene (default: 343 m/s)
+   */
+  void setSpeedOfSound(float metersPerSecond) { _speed = metersPerSecond; }
+
+  /**
+   * @brief Distance of a target at a virtual time, in cm
+   */
+  float distanceAt(uint8_t target, unsigned long time) const;
+
+  /**
+   * @brief Triggers answered by a sensor (triggers while busy are ignored)
+   */
+  unsigned long pings(uint8_t sensor) const { return _sensors[sensor].pings; }
+
+private:
+  struct Sensor
+  {
+    uint8_t trigPin;
+    uint8_t echoPin;
+    float bearing;
+    float halfAngle;
+    unsigned long lastFire;   // Time of the last answered trigger
+    unsigned long busyUntil;  // Echo pin HIGH until then; triggers are ignored
+    unsigned long pings;
+  };
+
+  static void onTrigger(uint8_t pin, unsigned long time, void *context);
+  void fire(Sensor &sensor, unsigned long time);
+
+  bool detectable(const Sensor &sensor, const Target &target, float distance) const;
+  unsigned long roundTrip(float distance) const;
+
+  uint32_t next();
+  float uniform();
+  float gaussian();
+
+  std::vector<Sensor> _sensors;
+  std::vector<Target> _targets;
+  uint32_t _state;
+  float _jitter;
+  float _dropout;
+  float _multipath;
+  float _crosstalk;
+  float _speed;
+};
+
+#endif // EchoSimulator_h
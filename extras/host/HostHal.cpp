@@ -0,0 +1,242 @@
+/*
+ * @file HostHal.cpp
+ * @brief Virtual clock and scripted pins behind the host Arduino.h
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @license MIT License
+ */
+
+#include "HostHal.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+  struct Pin
+  {
+    uint8_t mode;
+    bool output;               // Level written with digitalWrite()
+    bool input;                // Level seen by digitalRead() in INPUT mode
+    unsigned long risingAt;    // When output last went HIGH
+    unsigned long triggers;    // Falling edges written
+    unsigned long lastWidth;   // Width of the last HIGH pulse written
+    hal::TriggerHandler handler;
+    void *context;
+  };
+
+  struct Edge
+  {
+    unsigned long time;
+    uint8_t pin;
+    bool high;
+  };
+
+  struct Echo
+  {
+    uint8_t echoPin;
+    unsigned long riseDelay;
+    unsigned long width;
+  };
+
+  unsigned long virtualTime = 0;
+  unsigned long callCost = 1;
+  Pin pins[hal::PIN_COUNT];
+  Echo echoes[hal::PIN_COUNT];
+  std::vector<Edge> edges;  // Sorted by time, equal times in scheduling order
+
+  // Apply every scheduled edge that is due
+  void settle()
+  {
+    size_t due = 0;
+    while (due < edges.size() && edges[due].time <= virtualTime)
+    {
+      pins[edges[due].pin].input = edges[due].high;
+      due++;
+    }
+    edges.erase(edges.begin(), edges.begin() + due);
+  }
+
+  void scriptedEcho(uint8_t pin, unsigned long time, void *context)
+  {
+    (void)pin;
+    const Echo &echo = *static_cast<const Echo *>(context);
+    if (echo.width == 0)
+    {
+      return;
+    }
+
+    hal::schedule(echo.echoPin, time + echo.riseDelay, true);
+    hal::schedule(echo.echoPin, time + echo.riseDelay + echo.width, false);
+  }
+}
+
+namespace hal
+{
+  void reset()
+  {
+    virtualTime = 0;
+    callCost = 1;
+    edges.clear();
+    for (uint8_t i = 0; i < PIN_COUNT; i++)
+    {
+      pins[i] = Pin{INPUT, false, false, 0, 0, 0, nullptr, nullptr};
+      echoes[i] = Echo{0, 0, 0};
+    }
+  }
+
+  unsigned long now()
+  {
+    return virtualTime;
+  }
+
+  void advance(unsigned long us)
+  {
+    virtualTime += us;
+  }
+
+  void setCallCost(unsigned long us)
+  {
+    callCost = (us != 0) ? us : 1;
+  }
+
+  void schedule(uint8_t pin, unsigned long time, bool high)
+  {
+    Edge edge = {time, pin, high};
+    edges.insert(std::upper_bound(edges.begin(), edges.end(), edge,
+                                  [](const Edge &a, const Edge &b) { return a.time < b.time; }),
+                 edge);
+  }
+
+  void onTrigger(uint8_t pin, TriggerHandler handler, void *context)
+  {
+    pins[pin].handler = handler;
+    pins[pin].context = context;
+  }
+
+  void scriptEcho(uint8_t trigPin, uint8_t echoPin, unsigned long riseDelay, unsigned long width)
+  {
+    echoes[trigPin] = Echo{echoPin, riseDelay, width};
+    onTrigger(trigPin, scriptedEcho, &echoes[trigPin]);
+  }
+
+  uint8_t mode(uint8_t pin)
+  {
+    return pins[pin].mode;
+  }
+
+  unsigned long triggerCount(uint8_t pin)
+  {
+    return pins[pin].triggers;
+  }
+
+  unsigned long lastPulseWidth(uint8_t pin)
+  {
+    return pins[pin].lastWidth;
+  }
+}
+
+// ===========================
+// Arduino core API
+// ===========================
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  pins[pin].mode = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  Pin &p = pins[pin];
+  bool high = value != LOW;
+  if (high && !p.output)
+  {
+    p.risingAt = virtualTime;
+  }
+  else if (!high && p.output)
+  {
+    p.triggers++;
+    p.lastWidth = virtualTime - p.risingAt;
+    p.output = false;
+    if (p.handler)
+    {
+      p.handler(pin, virtualTime, p.context);
+    }
+  }
+  p.output = high;
+}
+
+int digitalRead(uint8_t pin)
+{
+  settle();
+  const Pin &p = pins[pin];
+  int level = (p.mode == OUTPUT) ? p.output : p.input;
+  virtualTime += callCost;
+  return level;
+}
+
+unsigned long micros(void)
+{
+  unsigned long time = virtualTime;
+  virtualTime += callCost;
+  return time;
+}
+
+unsigned long millis(void)
+{
+  return virtualTime / 1000UL;
+}
+
+void delay(unsigned long ms)
+{
+  virtualTime += ms * 1000UL;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  virtualTime += us;
+}
+
+size_t Print::print(char c)
+{
+  return write((uint8_t)c);
+}
+
+size_t Print::print(const char *text)
+{
+  size_t n = 0;
+  while (*text)
+  {
+    n += write((uint8_t)*text++);
+  }
+  return n;
+}
+
+size_t Print::print(unsigned long number)
+{
+  char digits[21];
+  char *p = digits + sizeof(digits) - 1;
+  *p = 0;
+  do
+  {
+    *--p = (char)('0' + number % 10);
+    number /= 10;
+  } while (number != 0);
+  return print(p);
+}
+
+size_t Print::println()
+{
+  return print("\r\n");
+}
+
+size_t Print::println(const char *text)
+{
+  return print(text) + println();
+}
+
+size_t Print::println(unsigned long number)
+{
+  return print(number) + println();
+}
@@ -0,0 +1,106 @@
+/*
+ * @file HostHal.h
+ * @brief Virtual clock and scripted pins behind the host Arduino.h
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @details Time only moves when the code under test asks for it: every
+ *          micros() and digitalRead() call costs a fixed number of virtual
+ *          microseconds, and delay()/delayMicroseconds() advance the clock
+ *          by exactly the requested amount. Input pins follow a schedule of
+ *          level changes, which trigger handlers fill in when the library
+ *          ends a trigger pulse. Results are therefore repeatable to the
+ *          microsecond on any host.
+ *
+ * @license MIT License
+ *
+ * @example
+ * hal::reset();
+ * hal::scriptEcho(12, 13, 450, 1164);  // 20 cm target
+ * MinimalUltrasonic sensor(12, 13);
+ * float cm = sensor.read();
+ */
+
+#ifndef HostHal_h
+#define HostHal_h
+
+#include <Arduino.h>
+
+namespace hal
+{
+  /**
+   * @brief Number of simulated pins
+   */
+  static const uint8_t PIN_COUNT = 64;
+
+  /**
+   * @brief Called when an output pin goes from HIGH to LOW
+   * @param pin The trigger pin
+   * @param time Virtual time of the falling edge in microseconds
+   * @param context Pointer given to onTrigger()
+   */
+  typedef void (*TriggerHandler)(uint8_t pin, unsigned long time, void *context);
+
+  /**
+   * @brief Return to time 0 with every pin LOW, INPUT and unscripted
+   */
+  void reset();
+
+  /**
+   * @brief Current virtual time in microseconds (does not advance the clock)
+   */
+  unsigned long now();
+
+  /**
+   * @brief Move the virtual clock forward
+   */
+  void advance(unsigned long us);
+
+  /**
+   * @brief Virtual microseconds consumed by each micros() and digitalRead() call
+   * @param us Cost per call (default: 1; at least 1 so polling loops end)
+   */
+  void setCallCost(unsigned long us);
+
+  /**
+   * @brief Schedule an input level change
+   * @param pin Pin to drive
+   * @param time Absolute virtual time of the change
+   * @param high New level
+   */
+  void schedule(uint8_t pin, unsigned long time, bool high);
+
+  /**
+   * @brief Call a handler on every falling edge of an output pin
+   * @param pin Trigger pin
+   * @param handler Handler, or nullptr to remove it
+   * @param context Passed to the handler unchanged
+   */
+  void onTrigger(uint8_t pin, TriggerHandler handler, void *context = nullptr);
+
+  /**
+   * @brief Answer every trigger on trigPin with the same echo pulse
+   * @param trigPin Trigger pin
+   * @param echoPin Echo pin (the same pin for 3-pin sensors)
+   * @param riseDelay Microseconds from the end of the trigger to the echo rising
+   * @param width Echo pulse width in microseconds (0: the echo never rises)
+   */
+  void scriptEcho(uint8_t trigPin, uint8_t echoPin, unsigned long riseDelay, unsigned long width);
+
+  /**
+   * @brief Current mode of a pin (INPUT or OUTPUT)
+   */
+  uint8_t mode(uint8_t pin);
+
+  /**
+   * @brief Number of falling edges written to a pin since reset()
+   */
+  unsigned long triggerCount(uint8_t pin);
+
+  /**
+   * @brief Length of the last HIGH pulse written to a pin, in microseconds
+   */
+  unsigned long lastPulseWidth(uint8_t pin);
+}
+
+#endif // HostHal_h
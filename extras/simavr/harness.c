@@ -0,0 +1,258 @@
+/*
+ * @file harness.c
+ * @brief Runs a driver sketch on a simulated ATmega328P with a scripted echo
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @details Loads an ELF built for arduino:avr:uno into simavr at 16 MHz.
+ *          Every falling edge on the trigger pin (D12, PB4) schedules an
+ *          echo pulse on D13 (PB5): HIGH after --rise µs, LOW --width µs
+ *          later. The sketch raises marker pins D8..D11 (PB0..PB3) around
+ *          the code being measured; for each marker the harness counts CPU
+ *          cycles inside the window and the cycles with the I flag clear.
+ *          Numbers the sketch prints on Serial are compared to --width to
+ *          give the measurement error.
+ *
+ *          The run stops after --reads windows of marker 0 and prints one
+ *          JSON object on stdout.
+ *
+ *          Unverified experiment: never compiled against simavr nor run;
+ *          see run.sh.
+ *
+ * @license MIT License
+ *
+ * @example
+ * harness read_cycles.ino.elf --width 5820 --reads 100
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avr_ioport.h"
+#include "avr_uart.h"
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_time.h"
+
+#define MARKERS 4
+#define TRIGGER_BIT 4  /* D12 */
+#define ECHO_BIT 5     /* D13 */
+
+typedef struct
+{
+  int active;
+  avr_cycle_count_t start;
+  avr_cycle_count_t masked;  /* Cycles with interrupts disabled in this window */
+  unsigned long windows;
+  avr_cycle_count_t total;
+  avr_cycle_count_t totalMasked;
+  avr_cycle_count_t min;
+  avr_cycle_count_t max;
+} marker_t;
+
+static avr_t *avr;
+static avr_irq_t *echo;
+static marker_t markers[MARKERS];
+static unsigned long riseUs = 450;
+static unsigned long widthUs = 1164;
+static int trigger = 0;
+
+static char line[32];
+static size_t lineLength = 0;
+static unsigned long samples = 0;
+static double errorSum = 0;
+static double errorMax = 0;
+
+static avr_cycle_count_t echoLevel(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+  (void)avr;
+  (void)when;
+  avr_raise_irq(echo, (uint32_t)(uintptr_t)param);
+  return 0;
+}
+
+static void onTrigger(avr_irq_t *irq, uint32_t value, void *param)
+{
+  (void)irq;
+  (void)param;
+  if (trigger && !value)
+  {
+    avr_cycle_timer_register_usec(avr, riseUs, echoLevel, (void *)1);
+    avr_cycle_timer_register_usec(avr, riseUs + widthUs, echoLevel, (void *)0);
+  }
+  trigger = value != 0;
+}
+
+static void onMarker(avr_irq_t *irq, uint32_t value, void *param)
+{
+  (void)irq;
+  marker_t *m = (marker_t *)param;
+  if (value && !m->active)
+  {
+    m->active = 1;
+    m->start = avr->cycle;
+    m->masked = 0;
+  }
+  else if (!value && m->active)
+  {
+    avr_cycle_count_t cycles = avr->cycle - m->start;
+    m->active = 0;
+    m->windows++;
+    m->total += cycles;
+    m->totalMasked += m->masked;
+    if (m->windows == 1 || cycles < m->min)
+    {
+      m->min = cycles;
+    }
+    if (cycles > m->max)
+    {
+      m->max = cycles;
+    }
+  }
+}
+
+static void onSerial(avr_irq_t *irq, uint32_t value, void *param)
+{
+  (void)irq;
+  (void)param;
+  char c = (char)value;
+  if (c == '\n')
+  {
+    line[lineLength] = 0;
+    lineLength = 0;
+
+    double error = atof(line) - (double)widthUs;
+    errorSum += error;
+    if (error < 0)
+    {
+      error = -error;
+    }
+    if (error > errorMax)
+    {
+      errorMax = error;
+    }
+    samples++;
+  }
+  else if (c != '\r' && lineLength + 1 < sizeof(line))
+  {
+    line[lineLength++] = c;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  const char *firmware = NULL;
+  unsigned long reads = 100;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--rise") && i + 1 < argc)
+    {
+      riseUs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--width") && i + 1 < argc)
+    {
+      widthUs = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!strcmp(argv[i], "--reads") && i + 1 < argc)
+    {
+      reads = strtoul(argv[++i], NULL, 10);
+    }
+    else if (!firmware && argv[i][0] != '-')
+    {
+      firmware = argv[i];
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s FIRMWARE.elf [--rise US] [--width US] [--reads N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (!firmware)
+  {
+    fprintf(stderr, "usage: %s FIRMWARE.elf [--rise US] [--width US] [--reads N]\n", argv[0]);
+    return 2;
+  }
+
+  elf_firmware_t f;
+  memset(&f, 0, sizeof(f));
+  if (elf_read_firmware(firmware, &f) != 0)
+  {
+    fprintf(stderr, "%s: cannot read firmware\n", firmware);
+    return 1;
+  }
+
+  avr = avr_make_mcu_by_name("atmega328p");
+  if (!avr)
+  {
+    fprintf(stderr, "simavr: no atmega328p core\n");
+    return 1;
+  }
+  avr_init(avr);
+  f.frequency = 16000000;
+  avr_load_firmware(avr, &f);
+
+  /* Keep the sketch's Serial output away from simavr's own console */
+  uint32_t flags = 0;
+  avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+  flags &= ~AVR_UART_FLAG_STDIO;
+  avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), onSerial, NULL);
+
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), TRIGGER_BIT), onTrigger, NULL);
+  echo = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), ECHO_BIT);
+  for (int i = 0; i < MARKERS; i++)
+  {
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), i), onMarker, &markers[i]);
+  }
+
+  /* One instruction per avr_run() call, so masked time is exact to the instruction */
+  int state = cpu_Running;
+  while (markers[0].windows < reads && state != cpu_Done && state != cpu_Crashed)
+  {
+    avr_cycle_count_t before = avr->cycle;
+    int masked = !avr->sreg[S_I];
+    state = avr_run(avr);
+    if (masked)
+    {
+      for (int i = 0; i < MARKERS; i++)
+      {
+        if (markers[i].active)
+        {
+          markers[i].masked += avr->cycle - before;
+        }
+      }
+    }
+  }
+
+  if (state == cpu_Crashed)
+  {
+    fprintf(stderr, "%s: simulated CPU crashed\n", firmware);
+    return 1;
+  }
+
+  printf("{\"firmware\": \"%s\", \"f_cpu\": 16000000, \"rise_us\": %lu, \"width_us\": %lu, ",
+         firmware, riseUs, widthUs);
+  printf("\"samples\": %lu, \"mean_error_us\": %.2f, \"max_error_us\": %.0f, \"markers\": [",
+         samples, samples ? errorSum / samples : 0.0, errorMax);
+  int first = 1;
+  for (int i = 0; i < MARKERS; i++)
+  {
+    marker_t *m = &markers[i];
+    if (!m->windows)
+    {
+      continue;
+    }
+    printf("%s{\"pin\": %d, \"windows\": %lu, \"cycles_min\": %llu, \"cycles_mean\": %.1f, "
+           "\"cycles_max\": %llu, \"masked_cycles_mean\": %.1f}",
+           first ? "" : ", ", 8 + i, m->windows, (unsigned long long)m->min,
+           (double)m->total / m->windows, (unsigned long long)m->max,
+           (double)m->totalMasked / m->windows);
+    first = 0;
+  }
+  printf("]}\n");
+
+  avr_terminate(avr);
+  return 0;
+}
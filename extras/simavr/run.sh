@@ -0,0 +1,83 @@
+#!/bin/sh
+# Cycle-accurate benchmarks of MinimalUltrasonic on a simulated ATmega328P.
+#
+# Builds the driver sketches in sketches/ for arduino:avr:uno, runs each one
+# under simavr (harness.c) against scripted echoes of several widths, and
+# prints one JSON array: CPU cycles per window, cycles with interrupts
+# masked, measurement error, and flash/RAM over the baseline sketch.
+# read_cycles is sized as library_*_bytes; median_cycles, which only uses
+# the header's inline median, as medians_*_bytes.
+#
+# UNVERIFIED EXPERIMENT: this script, harness.c and the sketches have never
+# been run end to end. No numbers from them are published, and they may
+# need fixes before the first run succeeds.
+#
+# Needs arduino-cli with the arduino:avr core, avr-size, a C compiler and
+# simavr's headers and library (libsimavr-dev, or simavr built from source).
+#
+#   extras/simavr/run.sh > simavr.json
+#   READS=20 WIDTHS="582 5820" extras/simavr/run.sh
+
+set -eu
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(cd "$HERE/../.." && pwd)
+BUILD=${BUILD:-"$HERE/build"}
+FQBN=${FQBN:-arduino:avr:uno}
+READS=${READS:-50}
+WIDTHS=${WIDTHS:-"582 5820 23280"}  # 10 cm, 1 m, 4 m
+
+mkdir -p "$BUILD"
+
+# Harness
+SIMAVR_FLAGS=$(pkg-config --cflags --libs simavr 2>/dev/null || echo "-I/usr/include/simavr -I/usr/local/include/simavr -lsimavr")
+# shellcheck disable=SC2086
+cc -O2 -std=c99 -o "$BUILD/harness" "$HERE/harness.c" $SIMAVR_FLAGS -lelf >&2
+
+# Sketches
+for sketch in baseline read_cycles median_cycles; do
+  arduino-cli compile --fqbn "$FQBN" --library "$ROOT" \
+    --output-dir "$BUILD/$sketch" "$HERE/sketches/$sketch" >&2
+done
+
+# Flash (.text + .data) and RAM (.data + .bss) of an ELF
+footprint() {
+  avr-size -A "$1" | awk '
+    $1 == ".text" { text = $2 }
+    $1 == ".data" { data = $2 }
+    $1 == ".bss"  { bss = $2 }
+    END { print text + data, data + bss }'
+}
+
+set -- $(footprint "$BUILD/baseline/baseline.ino.elf")
+BASE_FLASH=$1
+BASE_RAM=$2
+
+echo "["
+first=1
+for sketch in read_cycles median_cycles; do
+  elf="$BUILD/$sketch/$sketch.ino.elf"
+  set -- $(footprint "$elf")
+  flash=$(($1 - BASE_FLASH))
+  ram=$(($2 - BASE_RAM))
+
+  # The median sketch does not ping, so one echo width is enough, and it
+  # uses nothing of the library but the inline median, so its footprint is
+  # reported under its own name
+  widths=$WIDTHS
+  code=library
+  if [ "$sketch" = median_cycles ]; then
+    widths=${WIDTHS%% *}
+    code=medians
+  fi
+
+  for width in $widths; do
+    run=$("$BUILD/harness" "$elf" --width "$width" --reads "$READS")
+    [ $first -eq 1 ] || echo ","
+    first=0
+    printf '  {"sketch": "%s", "%s_flash_bytes": %d, "%s_ram_bytes": %d, "run": %s}' \
+      "$sketch" "$code" "$flash" "$code" "$ram" "$run"
+  done
+done
+echo
+echo "]"
@@ -0,0 +1,21 @@
+/*
+ * simavr baseline: the same Serial and marker code as the other driver
+ * sketches, without the library. Its flash and RAM are subtracted from
+ * theirs to get the library's own footprint.
+ */
+
+void setup()
+{
+  Serial.begin(115200);
+  DDRB |= _BV(0) | _BV(1);  // Markers on D8 and D9
+}
+
+void loop()
+{
+  PORTB |= _BV(0);
+  unsigned long value = micros();
+  PORTB &= ~_BV(0);
+
+  Serial.println(value);
+  delay(10);
+}
@@ -0,0 +1,83 @@
+/*
+ * simavr driver: the min/max median of 3 against the bubble sort the
+ * Advanced example used before it, on the same varied inputs.
+ *
+ * D8 (PB0) marks MinimalUltrasonic::median3(), the network readMedian3()
+ * uses, called without a ping. D9 (PB1) marks the bubble sort of the same
+ * three durations. Only the header's inline median is used, so run.sh
+ * reports this sketch's footprint as that of the two medians, not of the
+ * library.
+ * Each loop draws new durations from a fixed-seed generator, so every
+ * order of the three values occurs and the sort swaps as often as it
+ * would on real echoes. Both windows include the same volatile loads and
+ * store, which keep the compiler from moving work across the markers.
+ * Nothing pings: the echo width the harness sends does not matter.
+ *
+ * Unverified: never run yet, see extras/simavr/run.sh.
+ */
+
+#include <Arduino.h>
+#include <MinimalUltrasonic.h>
+
+volatile uint16_t input[3];
+volatile uint16_t result;
+uint16_t state = 0xACE1;
+
+void setup()
+{
+  DDRB |= _BV(0) | _BV(1);  // Markers on D8 and D9
+}
+
+/**
+ * Next pseudo-random duration: xorshift16, kept to the 0..32767 µs range
+ */
+uint16_t nextDuration()
+{
+  state ^= state << 7;
+  state ^= state >> 9;
+  state ^= state << 8;
+  return state & 0x7FFF;
+}
+
+/**
+ * Bubble sort from the v2.0.0 Advanced example, on three samples
+ */
+uint16_t bubbleMedian(uint16_t *values, uint8_t count)
+{
+  uint16_t sorted[3];
+  for (uint8_t i = 0; i < count; i++)
+  {
+    sorted[i] = values[i];
+  }
+  for (uint8_t i = 0; i < count - 1; i++)
+  {
+    for (uint8_t j = i + 1; j < count; j++)
+    {
+      if (sorted[i] > sorted[j])
+      {
+        uint16_t swap = sorted[i];
+        sorted[i] = sorted[j];
+        sorted[j] = swap;
+      }
+    }
+  }
+  return sorted[count / 2];
+}
+
+void loop()
+{
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    input[i] = nextDuration();
+  }
+
+  // Direct port writes keep the markers to two cycles each
+  PORTB |= _BV(0);
+  result = MinimalUltrasonic::median3(input[0], input[1], input[2]);
+  PORTB &= ~_BV(0);
+
+  PORTB |= _BV(1);
+  uint16_t values[3] = {input[0], input[1], input[2]};
+  result = bubbleMedian(values, 3);
+  PORTB &= ~_BV(1);
+}
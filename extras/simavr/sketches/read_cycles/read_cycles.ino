@@ -0,0 +1,29 @@
+/*
+ * simavr driver: one measure() per loop between markers on D8 (PB0).
+ * The harness answers the trigger on D12 with a scripted echo on D13 and
+ * compares the printed duration with the echo it sent. The timeout is
+ * raised to 30 ms so the longest default width (4 m, 23280 µs) is read as
+ * an echo instead of timing the STUCK_HIGH path.
+ */
+
+#include <MinimalUltrasonic.h>
+
+MinimalUltrasonic sensor(12, 13);
+
+void setup()
+{
+  Serial.begin(115200);
+  sensor.setTimeout(30000UL);  // ~5.1 m, past the 4 m run
+  DDRB |= _BV(0) | _BV(1);  // Markers on D8 and D9
+}
+
+void loop()
+{
+  // Direct port writes keep the markers to two cycles each
+  PORTB |= _BV(0);
+  MinimalUltrasonic::Reading reading = sensor.measure();
+  PORTB &= ~_BV(0);
+
+  Serial.println(reading.duration);
+  delay(10);
+}
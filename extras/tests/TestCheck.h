@@ -0,0 +1,48 @@
+/*
+ * @file TestCheck.h
+ * @brief Assertion macros for the host tests
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @details Each test is a plain executable: checks print the failing
+ *          expression and keep going, and TEST_RESULT() turns the number of
+ *          failures into the exit code that ctest reads.
+ *
+ * @license MIT License
+ */
+
+#ifndef TestCheck_h
+#define TestCheck_h
+
+#include <math.h>
+#include <stdio.h>
+
+static int checkFailures = 0;
+
+#define CHECK(condition)                                                   \
+  do                                                                       \
+  {                                                                        \
+    if (!(condition))                                                      \
+    {                                                                      \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      checkFailures++;                                                     \
+    }                                                                      \
+  } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance)                          \
+  do                                                                     \
+  {                                                                      \
+    double a_ = (actual), e_ = (expected);                               \
+    if (fabs(a_ - e_) > (tolerance))                                     \
+    {                                                                    \
+      printf("%s:%d: %s = %f, expected %f +/- %f\n", __FILE__, __LINE__, \
+             #actual, a_, e_, (double)(tolerance));                      \
+      checkFailures++;                                                   \
+    }                                                                    \
+  } while (0)
+
+#define TEST_RESULT()                                      \
+  (checkFailures == 0 ? (printf("all checks passed\n"), 0) \
+                     : (printf("%d check(s) failed\n", checkFailures), 1))
+
+#endif // TestCheck_h
@@ -0,0 +1,79 @@
+/*
+ * @file test_conversion.cpp
+ * @brief Unit conversion, fixed-point and threshold arithmetic
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @license MIT License
+ */
+
+#include <MinimalUltrasonic.h>
+
+#include "TestCheck.h"
+
+static MinimalUltrasonic::Reading okReading(uint16_t duration)
+{
+  MinimalUltrasonic::Reading reading = {0, duration, MinimalUltrasonic::OK, 255};
+  return reading;
+}
+
+static void testUnits()
+{
+  // 582 µs round trip is exactly 10 cm at 29.1 µs/cm
+  MinimalUltrasonic::Reading r = okReading(582);
+  CHECK_NEAR(r.distance(MinimalUltrasonic::CM), 10.0, 1e-4);
+  CHECK_NEAR(r.distance(MinimalUltrasonic::METERS), 0.1, 1e-6);
+  CHECK_NEAR(r.distance(MinimalUltrasonic::MM), 100.0, 1e-3);
+  CHECK_NEAR(r.distance(MinimalUltrasonic::INCHES), 10.0 / 2.54, 1e-4);
+  CHECK_NEAR(r.distance(MinimalUltrasonic::YARDS), 10.0 / 91.44, 1e-6);
+  CHECK_NEAR(r.distance(MinimalUltrasonic::MILES), 10.0 / 160934.4, 1e-9);
+
+  CHECK_NEAR(MinimalUltrasonic::convertFromCm(254, MinimalUltrasonic::INCHES), 100.0, 1e-3);
+
+  // Failed readings convert to 0 in every unit
+  r.status = MinimalUltrasonic::NO_ECHO;
+  for (uint8_t unit = 0; unit < MinimalUltrasonic::UNIT_COUNT; unit++)
+  {
+    CHECK(r.distance((MinimalUltrasonic::Unit)unit) == 0);
+  }
+  CHECK(r.micrometers() == 0);
+}
+
+static void testMicrometers()
+{
+  // The fixed-point path stays within 1 µm of the exact value everywhere
+  double worst = 0;
+  for (uint32_t duration = 0; duration <= 0xFFFF; duration++)
+  {
+    double exact = duration * 10000.0 / (2 * 29.1);
+    double error = fabs((double)okReading((uint16_t)duration).micrometers() - exact);
+    if (error > worst)
+    {
+      worst = error;
+    }
+  }
+  CHECK(worst <= 1.0);
+  printf("readMicrometers worst error: %.3f um\n", worst);
+}
+
+static void testThresholds()
+{
+  CHECK(MinimalUltrasonic::Threshold(10).duration == 582);
+  CHECK(MinimalUltrasonic::Threshold(0.1, MinimalUltrasonic::METERS).duration == 582);
+  CHECK(MinimalUltrasonic::Threshold(100, MinimalUltrasonic::MM).duration == 582);
+  CHECK(MinimalUltrasonic::Threshold(0).duration == 0);
+
+  // Very large distances saturate instead of wrapping
+  CHECK(MinimalUltrasonic::Threshold(1e9).duration == 0xFFFFFFFFUL);
+
+  CHECK(okReading(581).closerThan(MinimalUltrasonic::Threshold(10)));
+  CHECK(!okReading(582).closerThan(MinimalUltrasonic::Threshold(10)));
+}
+
+int main()
+{
+  testUnits();
+  testMicrometers();
+  testThresholds();
+  return TEST_RESULT();
+}
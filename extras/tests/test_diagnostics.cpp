@@ -0,0 +1,269 @@
+/*
+ * @file test_diagnostics.cpp
+ * @brief Optional diagnostics, built with every MINIMAL_ULTRASONIC_* switch on
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @license MIT License
+ */
+
+#include <HostHal.h>
+#include <MinimalUltrasonic.h>
+
+#include "TestCheck.h"
+
+#include <string>
+
+/**
+ * @brief Print that keeps everything written to it
+ */
+class Capture : public Print
+{
+public:
+  std::string text;
+
+  size_t write(uint8_t c) override
+  {
+    text += (char)c;
+    return 1;
+  }
+};
+
+static const uint8_t TRIG = 12;
+static const uint8_t ECHO = 13;
+
+static void testStats()
+{
+  hal::reset();
+  MinimalUltrasonic sensor(TRIG, ECHO, 5000UL);
+  sensor.setMinDistance(2);
+
+  const MinimalUltrasonic::Stats &stats = sensor.getStats();
+  CHECK(stats.pings == 0);
+  CHECK(stats.minRaw == 0xFFFF);
+
+  hal::scriptEcho(TRIG, ECHO, 450, 1164);
+  sensor.measure();
+  hal::advance(60000UL);
+  hal::scriptEcho(TRIG, ECHO, 450, 2328);
+  sensor.measure();
+  hal::advance(60000UL);
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  sensor.measure();
+  hal::scriptEcho(TRIG, ECHO, 450, 30000);
+  sensor.measure();
+  hal::advance(60000UL);
+  hal::scriptEcho(TRIG, ECHO, 450, 58);
+  sensor.measure();
+
+  CHECK(stats.pings == 5);
+  CHECK(stats.valid == 2);
+  CHECK(stats.noEcho == 1);
+  CHECK(stats.stuckHigh == 1);
+  CHECK(stats.outOfGate == 1);
+  CHECK(stats.minRaw >= 1164 && stats.minRaw <= 1168);
+  CHECK(stats.maxRaw >= 2328 && stats.maxRaw <= 2332);
+
+  // Two timeouts of 5 ms plus three echoes (and their 450 µs burst delays)
+  unsigned long expected = 2 * 5000UL + 1164 + 2328 + 58 + 5 * 450;
+  CHECK_NEAR(stats.blockedMicros, expected, 600);
+
+  // A ping stopped at a threshold is not a failure
+  hal::advance(60000UL);
+  hal::scriptEcho(TRIG, ECHO, 450, 2328);
+  CHECK(!sensor.closerThan(MinimalUltrasonic::Threshold(20)));
+  CHECK(stats.pings == 6);
+  CHECK(stats.beyondLimit == 1);
+  CHECK(stats.outOfGate == 1);
+
+  // Suppressed pings are not pings
+  sensor.setPingInterval(60000UL);
+  sensor.measure();
+  sensor.measure();
+  CHECK(stats.pings == 6);
+
+  sensor.resetStats();
+  CHECK(stats.pings == 0 && stats.valid == 0 && stats.beyondLimit == 0 && stats.blockedMicros == 0);
+  CHECK(stats.minRaw == 0xFFFF && stats.maxRaw == 0);
+}
+
+static void testUnitCache()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, 1164);
+  MinimalUltrasonic sensor(TRIG, ECHO);
+  sensor.setPingInterval(60000UL);
+
+  // Values cached by readAll() survive a suppressed ping
+  MinimalUltrasonic::Distances d;
+  CHECK(sensor.readAll(d).ok());
+  CHECK(sensor.readAll(d).status == MinimalUltrasonic::TOO_SOON);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::MM), 200.0, 1.0);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::INCHES), 20.0 / 2.54, 0.05);
+
+  // A new ping replaces every cached unit
+  hal::scriptEcho(TRIG, ECHO, 450, 4656);
+  hal::advance(60000UL);
+  CHECK_NEAR(sensor.read(), 80.0, 0.1);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::MM), 800.0, 1.0);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::INCHES), 80.0 / 2.54, 0.05);
+
+  // A failed one clears them
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  hal::advance(60000UL);
+  CHECK(sensor.read(MinimalUltrasonic::MM) == 0);
+  CHECK(sensor.lastDistance(MinimalUltrasonic::INCHES) == 0);
+}
+
+static int bucketOf(const uint16_t *buckets)
+{
+  int found = -1;
+  for (int i = 0; i < MinimalUltrasonic::HISTOGRAM_BUCKETS; i++)
+  {
+    if (buckets[i] != 0)
+    {
+      found = (found == -1) ? i : -2;
+    }
+  }
+  return found;
+}
+
+static void testTimingHistogram()
+{
+  hal::reset();
+  MinimalUltrasonic sensor(TRIG, ECHO, 5000UL);
+  const MinimalUltrasonic::TimingHistogram &histogram = sensor.getTimingHistogram();
+  CHECK(bucketOf(histogram.rise) == -1);
+
+  // 12 µs trigger, 450 µs to the rise, 1164 µs echo: buckets 8, 256 and 1024
+  hal::scriptEcho(TRIG, ECHO, 450, 1164);
+  sensor.measure();
+  hal::advance(60000UL);
+  sensor.measure();
+  CHECK(bucketOf(histogram.trigger) == 4);
+  CHECK(bucketOf(histogram.rise) == 9);
+  CHECK(bucketOf(histogram.pulse) == 11);
+  CHECK(histogram.pulse[11] == 2);
+
+  // A missed echo costs the whole 5 ms timeout in the rise phase
+  hal::advance(60000UL);
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  sensor.measure();
+  CHECK(histogram.rise[13] == 1);
+  CHECK(histogram.pulse[11] == 2);
+
+  // An echo that never ends lands in the pulse phase
+  hal::scriptEcho(TRIG, ECHO, 450, 30000);
+  sensor.measure();
+  CHECK(histogram.rise[9] == 3);
+  CHECK(histogram.pulse[13] == 1);
+
+  Capture out;
+  sensor.printTimingHistogram(out);
+  CHECK(out.text.compare(0, 23, "us\ttrigger\trise\tpulse\r\n") == 0);
+  CHECK(out.text.find("\r\n8\t4\t0\t0\r\n") != std::string::npos);
+  CHECK(out.text.find("\r\n256\t0\t3\t0\r\n") != std::string::npos);
+  CHECK(out.text.find("\r\n4096\t0\t1\t1\r\n") != std::string::npos);
+  CHECK(out.text.find("\r\n16384\t0\t0\t0\r\n") != std::string::npos);
+
+  sensor.resetTimingHistogram();
+  CHECK(bucketOf(histogram.trigger) == -1);
+  CHECK(bucketOf(histogram.pulse) == -1);
+}
+
+static std::string traceDump;
+
+static void testTrace()
+{
+  hal::reset();
+  MinimalUltrasonic sensor(TRIG, ECHO, 5000UL);
+  sensor.setMinDistance(2);
+  CHECK(sensor.traceLength() == 0);
+
+  hal::scriptEcho(TRIG, ECHO, 450, 2328);
+  sensor.measure();
+  hal::advance(60000UL);
+  CHECK(sensor.traceLength() == 1);
+  CHECK(sensor.getTrace(0).status == MinimalUltrasonic::OK);
+
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  sensor.measure();
+  hal::scriptEcho(TRIG, ECHO, 450, 30000);
+  sensor.measure();
+  hal::advance(60000UL);
+  hal::scriptEcho(TRIG, ECHO, 450, 58);
+  sensor.measure();
+  hal::advance(60000UL);
+  hal::scriptEcho(TRIG, ECHO, 450, 1164);
+  unsigned long before = hal::now();
+  sensor.measure();
+
+  // Five pings in a ring of four: the first one is gone
+  CHECK(sensor.traceLength() == 4);
+  const MinimalUltrasonic::TraceEntry &missed = sensor.getTrace(0);
+  CHECK(missed.status == MinimalUltrasonic::NO_ECHO);
+  CHECK(missed.rise == 0 && missed.fall == 0);
+
+  const MinimalUltrasonic::TraceEntry &stuck = sensor.getTrace(1);
+  CHECK(stuck.status == MinimalUltrasonic::STUCK_HIGH);
+  CHECK_NEAR(stuck.rise, 450, 3);
+  CHECK(stuck.fall == 0);
+
+  // Rejected after timing() by the minimum distance: the final status is kept
+  const MinimalUltrasonic::TraceEntry &close = sensor.getTrace(2);
+  CHECK(close.status == MinimalUltrasonic::OUT_OF_GATE);
+  CHECK_NEAR(close.fall - close.rise, 58, 3);
+
+  const MinimalUltrasonic::TraceEntry &last = sensor.getTrace(3);
+  CHECK(last.status == MinimalUltrasonic::OK);
+  CHECK_NEAR(last.trigger, before + 14, 3);
+  CHECK_NEAR(last.rise, 450, 3);
+  CHECK_NEAR(last.fall - last.rise, 1164, 3);
+  CHECK(last.trigger > close.trigger && close.trigger > stuck.trigger);
+
+  Capture out;
+  sensor.dumpTrace(out);
+  CHECK(out.text.size() == 5 + 4 * 9 + 1);
+  CHECK(out.text.compare(0, 5, std::string("MUT\x01\x04", 5)) == 0);
+  CHECK((uint8_t)out.text[5 + 3 * 9 + 8] == MinimalUltrasonic::OK);
+  CHECK((uint8_t)out.text[5 + 3 * 9 + 4] == (last.rise & 0xFF));
+  uint8_t check = 0;
+  for (size_t i = 0; i < out.text.size(); i++)
+  {
+    check ^= (uint8_t)out.text[i];
+  }
+  CHECK(check == 0);
+  traceDump = out.text;
+
+  sensor.clearTrace();
+  CHECK(sensor.traceLength() == 0);
+  Capture empty;
+  sensor.dumpTrace(empty);
+  CHECK(empty.text.size() == 6);
+}
+
+/**
+ * @brief Optional argument: file to write the trace dump to, with some text
+ * around it as on a serial port, for the decode_trace test
+ */
+int main(int argc, char **argv)
+{
+  testUnitCache();
+  testStats();
+  testTimingHistogram();
+  testTrace();
+
+  if (argc > 1)
+  {
+    FILE *f = fopen(argv[1], "wb");
+    CHECK(f != nullptr);
+    if (f)
+    {
+      fputs("booting\r\n", f);
+      fwrite(traceDump.data(), 1, traceDump.size(), f);
+      fputs("done\r\n", f);
+      fclose(f);
+    }
+  }
+  return TEST_RESULT();
+}
@@ -0,0 +1,161 @@
+/*
+ * @file test_filters.cpp
+ * @brief Streaming filters against brute-force references and synthetic tracks
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @license MIT License
+ */
+
+#include <MinimalUltrasonicFilters.h>
+
+#include <algorithm>
+#include <stdlib.h>
+
+#include "TestCheck.h"
+
+static MinimalUltrasonic::Reading okReading(uint32_t timestamp, uint16_t duration)
+{
+  MinimalUltrasonic::Reading reading = {timestamp, duration, MinimalUltrasonic::OK, 255};
+  return reading;
+}
+
+static void testMedian()
+{
+  UltrasonicMedianFilter<5> median;
+  uint16_t window[5];
+  srand(1);
+
+  for (int i = 0; i < 1000; i++)
+  {
+    uint16_t sample = 500 + rand() % 2000;
+    window[i % 5] = sample;
+    uint16_t filtered = median.update(okReading(i * 60000UL, sample)).duration;
+
+    if (i >= 4)
+    {
+      uint16_t sorted[5];
+      std::copy(window, window + 5, sorted);
+      std::sort(sorted, sorted + 5);
+      CHECK(filtered == sorted[2]);
+    }
+  }
+
+  // Failed readings pass through and leave the window alone
+  MinimalUltrasonic::Reading failed = {0, 0, MinimalUltrasonic::NO_ECHO, 0};
+  uint16_t before = median.value();
+  CHECK(median.update(failed).status == MinimalUltrasonic::NO_ECHO);
+  CHECK(median.value() == before);
+}
+
+static void testHampel()
+{
+  UltrasonicHampelFilter<7> hampel;
+  srand(2);
+
+  for (int i = 0; i < 200; i++)
+  {
+    uint16_t sample = 1164 + rand() % 11 - 5;
+    bool spike = i > 10 && i % 17 == 0;
+    if (spike)
+    {
+      sample = 4000;
+    }
+
+    uint16_t filtered = hampel.update(okReading(i * 60000UL, sample)).duration;
+    CHECK(hampel.wasOutlier() == spike);
+    CHECK(filtered < 1200);
+  }
+  CHECK(hampel.total() == 200);
+  CHECK(hampel.rejected() == 11);
+}
+
+static void testKalman()
+{
+  UltrasonicKalmanFilter kalman;
+
+  // Target approaching at 50 cm/s from 200 cm, one ping every 50 ms
+  for (int i = 0; i <= 40; i++)
+  {
+    float cm = 200 - 50 * 0.05f * i;
+    kalman.update(okReading(i * 50000UL, (uint16_t)(cm * 58.2f + 0.5f)));
+  }
+  CHECK(kalman.initialized());
+  CHECK_NEAR(kalman.distance(), 100.0, 1.0);
+  CHECK_NEAR(kalman.velocity(), -50.0, 5.0);
+}
+
+static void testCollision()
+{
+  UltrasonicCollisionEstimator<8> ttc;
+  CHECK(ttc.timeToCollision() == UltrasonicCollisionEstimator<8>::NO_COLLISION);
+
+  // 1 m/s towards a target starting at 200 cm, one ping every 20 ms
+  for (int i = 0; i < 20; i++)
+  {
+    float cm = 200 - 100 * 0.02f * i;
+    ttc.update(okReading(i * 20000UL, (uint16_t)(cm * 58.2f + 0.5f)));
+  }
+  CHECK_NEAR(ttc.closingSpeed(), 1000.0, 20.0);
+  CHECK_NEAR(ttc.timeToCollision(), 1620.0, 40.0);
+
+  // A receding target never collides
+  ttc.reset();
+  for (int i = 0; i < 8; i++)
+  {
+    ttc.update(okReading(i * 20000UL, (uint16_t)(1000 + 20 * i)));
+  }
+  CHECK(ttc.closingSpeed() < 0);
+  CHECK(ttc.timeToCollision() == UltrasonicCollisionEstimator<8>::NO_COLLISION);
+
+  // Moving away is rounded like approaching: 1 µs per 32 ms is 31 µs/s,
+  // 5.3 mm/s either way
+  ttc.reset();
+  for (int i = 0; i < 8; i++)
+  {
+    ttc.update(okReading(i * 32000UL, (uint16_t)(1000 - i)));
+  }
+  CHECK(ttc.closingSpeed() == 5);
+  ttc.reset();
+  for (int i = 0; i < 8; i++)
+  {
+    ttc.update(okReading(i * 32000UL, (uint16_t)(1000 + i)));
+  }
+  CHECK(ttc.closingSpeed() == -5);
+
+  // Pings 500 ms apart (setAdaptiveRate() at its slowest) keep the window
+  // by default; a shorter maxGap restarts it on every sample
+  UltrasonicCollisionEstimator<4> resting;
+  UltrasonicCollisionEstimator<4> strict(400000UL);
+  for (int i = 0; i < 4; i++)
+  {
+    MinimalUltrasonic::Reading r = okReading(i * 500000UL, (uint16_t)(5000 - 100 * i));
+    resting.update(r);
+    strict.update(r);
+  }
+  CHECK(resting.count() == 4);
+  CHECK_NEAR(resting.closingSpeed(), 34.0, 1.0);
+  CHECK(strict.count() == 1);
+  CHECK(strict.closingSpeed() == 0);
+
+  // A slow loop (16 pings, 400 ms apart) at the far end of the range, across
+  // the 32-bit micros() wrap: the sums must neither overflow nor jump
+  UltrasonicCollisionEstimator<16> slow;
+  uint32_t start = 0xFFFFFFFFUL - 3000000UL;
+  for (int i = 0; i < 16; i++)
+  {
+    float cm = 1100 - 50 * 0.4f * i;  // 50 cm/s from 11 m
+    slow.update(okReading(start + i * 400000UL, (uint16_t)(cm * 58.2f + 0.5f)));
+  }
+  CHECK_NEAR(slow.closingSpeed(), 500.0, 5.0);
+  CHECK_NEAR(slow.timeToCollision(), 16000.0, 100.0);
+}
+
+int main()
+{
+  testMedian();
+  testHampel();
+  testKalman();
+  testCollision();
+  return TEST_RESULT();
+}
@@ -0,0 +1,671 @@
+/*
+ * @file test_measure.cpp
+ * @brief Ping timing, status codes and calibration against scripted echoes
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @license MIT License
+ */
+
+#include <HostHal.h>
+#include <MinimalUltrasonic.h>
+
+#include "TestCheck.h"
+
+static const uint8_t TRIG = 12;
+static const uint8_t ECHO = 13;
+
+/**
+ * @brief Echo width in microseconds for a target at the given distance
+ */
+static unsigned long widthFor(float cm)
+{
+  return (unsigned long)(cm * 2 * 29.1 + 0.5);
+}
+
+/**
+ * @brief Loop period between pings, so the previous echo has ended
+ */
+static const unsigned long PING_PERIOD = 60000UL;
+
+static MinimalUltrasonic::Reading pingLater(MinimalUltrasonic &sensor)
+{
+  hal::advance(PING_PERIOD);
+  return sensor.measure();
+}
+
+static float readLater(MinimalUltrasonic &sensor)
+{
+  hal::advance(PING_PERIOD);
+  return sensor.read();
+}
+
+/**
+ * @brief Echo widths answered in turn, 0 for no echo
+ */
+struct EchoSequence
+{
+  const unsigned long *widths;
+  uint8_t count;
+  uint8_t next;
+};
+
+static void playSequence(uint8_t, unsigned long time, void *context)
+{
+  EchoSequence *sequence = (EchoSequence *)context;
+  unsigned long width = sequence->widths[sequence->next];
+  sequence->next = (sequence->next + 1) % sequence->count;
+  if (width != 0)
+  {
+    hal::schedule(ECHO, time + 450, true);
+    hal::schedule(ECHO, time + 450 + width, false);
+  }
+}
+
+static void testTrigger()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(20));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+
+  CHECK(hal::mode(TRIG) == OUTPUT);
+  CHECK(hal::mode(ECHO) == INPUT);
+
+  sensor.read();
+  CHECK(hal::triggerCount(TRIG) == 1);
+  CHECK(hal::lastPulseWidth(TRIG) == 10);
+}
+
+static void testEcho()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(20));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+
+  MinimalUltrasonic::Reading r = sensor.measure();
+  CHECK(r.ok());
+  CHECK_NEAR(r.distance(), 20.0, 0.1);
+  CHECK_NEAR(sensor.read(MinimalUltrasonic::MM), 200.0, 1.0);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::METERS), 0.2, 0.001);
+  CHECK_NEAR(sensor.readMicrometers(), 200000.0, 1000.0);
+
+  // read() and readMicrometers() work through a const reference, as in 1.x
+  const MinimalUltrasonic &view = sensor;
+  CHECK_NEAR(view.read(), 20.0, 0.1);
+  CHECK_NEAR(view.readMicrometers(), 200000.0, 1000.0);
+
+  MinimalUltrasonic::Distances d;
+  CHECK(sensor.readAll(d).ok());
+  CHECK_NEAR(d[MinimalUltrasonic::INCHES], 20.0 / 2.54, 0.05);
+}
+
+static void testMaxDistance()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(200));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+
+  // The timeout follows the distance in any unit, and bounds the wait
+  sensor.setMaxDistance(1.5, MinimalUltrasonic::METERS);
+  CHECK(sensor.getTimeout() == 8730);
+  unsigned long start = hal::now();
+  CHECK(sensor.measure().status == MinimalUltrasonic::STUCK_HIGH);
+  CHECK(hal::now() - start < 450 + 8730 + 100);
+
+  sensor.setMaxDistance(100, MinimalUltrasonic::INCHES);
+  CHECK(sensor.getTimeout() == 14783);
+  CHECK_NEAR(readLater(sensor), 200.0, 0.1);
+
+  // Distances beyond the unsigned long range saturate instead of wrapping
+  sensor.setMaxDistance(1e9, MinimalUltrasonic::MILES);
+  CHECK(sensor.getTimeout() == 0xFFFFFFFFUL);
+  sensor.setMaxDistance(4000000000U);
+  CHECK(sensor.getTimeout() == 0xFFFFFFFFUL);
+  sensor.setMaxDistance(500U);
+  CHECK(sensor.getTimeout() == 29100);
+  sensor.setMaxDistance(-1.0, MinimalUltrasonic::CM);
+  CHECK(sensor.getTimeout() == 0);
+}
+
+static void testSmoothing()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(100));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+  sensor.setSmoothing(2);
+  CHECK(sensor.getSmoothing() == 2);
+
+  // The first echo seeds the average, later ones move it by 1/4 of the step
+  CHECK_NEAR(readLater(sensor), 100.0, 0.1);
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(120));
+  CHECK_NEAR(readLater(sensor), 105.0, 0.1);
+  CHECK_NEAR(readLater(sensor), 108.75, 0.1);
+  for (int i = 0; i < 30; i++)
+  {
+    readLater(sensor);
+  }
+  CHECK_NEAR(readLater(sensor), 120.0, 0.1);
+
+  // Failed pings leave the average alone
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  CHECK(readLater(sensor) == 0);
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(120));
+  CHECK_NEAR(readLater(sensor), 120.0, 0.1);
+
+  // The shift is clamped to 15, and 0 turns smoothing off
+  sensor.setSmoothing(20);
+  CHECK(sensor.getSmoothing() == 15);
+  sensor.setSmoothing(0);
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(100));
+  CHECK_NEAR(readLater(sensor), 100.0, 0.1);
+}
+
+static void testSmoothingCloserThan()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(100));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+  sensor.setSmoothing(3);
+  for (int i = 0; i < 10; i++)
+  {
+    readLater(sensor);
+  }
+
+  // An obstacle appears: the first ping sees it, while the average lags
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(20));
+  hal::advance(PING_PERIOD);
+  CHECK(sensor.closerThan(MinimalUltrasonic::Threshold(30)));
+  CHECK_NEAR(sensor.lastDistance(), 90.0, 0.2);
+
+  // A suppressed ping answers from the last echo, not from the average
+  sensor.setPingInterval(PING_PERIOD);
+  hal::advance(PING_PERIOD);
+  CHECK(sensor.read() > 70);
+  CHECK(sensor.closerThan(MinimalUltrasonic::Threshold(30)));
+  CHECK(sensor.lastReading().distance() > 70);
+}
+
+static void testThreePin()
+{
+  hal::reset();
+  hal::scriptEcho(7, 7, 450, widthFor(50));
+  MinimalUltrasonic sensor(7);
+
+  CHECK_NEAR(sensor.read(), 50.0, 0.1);
+  CHECK(hal::mode(7) == INPUT);
+}
+
+static void testFailures()
+{
+  // Nothing answers: give up after the timeout
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  MinimalUltrasonic silent(TRIG, ECHO, 5000UL);
+  unsigned long start = hal::now();
+  CHECK(silent.measure().status == MinimalUltrasonic::NO_ECHO);
+  CHECK(silent.read() == 0);
+  CHECK(hal::now() - start < 2 * 5100UL);
+
+  // Echo longer than the timeout
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, 30000);
+  MinimalUltrasonic stuck(TRIG, ECHO, 5000UL);
+  CHECK(stuck.measure().status == MinimalUltrasonic::STUCK_HIGH);
+
+  // Echo inside the minimum distance
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(1));
+  MinimalUltrasonic close(TRIG, ECHO);
+  close.setMinDistance(2);
+  CHECK(close.measure().status == MinimalUltrasonic::OUT_OF_GATE);
+
+  // Echo too long for a Reading: a failure, not a saturated distance
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, 70000);
+  MinimalUltrasonic far(TRIG, ECHO, 80000UL);
+  CHECK(far.measure().status == MinimalUltrasonic::OUT_OF_GATE);
+  CHECK(readLater(far) == 0);
+  MinimalUltrasonic::Calibration c = {0, MinimalUltrasonic::CALIBRATION_UNITY * 3 / 4};
+  CHECK(far.setCalibration(c));
+  CHECK(pingLater(far).status == MinimalUltrasonic::OUT_OF_GATE);
+}
+
+static void testPingInterval()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(20));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+  sensor.setPingInterval(60000UL);
+
+  CHECK(sensor.measure().ok());
+  CHECK(sensor.measure().status == MinimalUltrasonic::TOO_SOON);
+  CHECK(hal::triggerCount(TRIG) == 1);
+
+  hal::advance(60000UL);
+  CHECK(sensor.measure().ok());
+  CHECK(hal::triggerCount(TRIG) == 2);
+}
+
+/**
+ * @brief Ping as soon as the current interval allows
+ */
+static MinimalUltrasonic::Reading pingWhenDue(MinimalUltrasonic &sensor)
+{
+  hal::advance(sensor.getPingInterval());
+  return sensor.measure();
+}
+
+static void testAdaptiveRate()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(100));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+  sensor.setAdaptiveRate(20000UL, 200000UL, MinimalUltrasonic::Threshold(2),
+                         MinimalUltrasonic::Threshold(20));
+
+  // A new target gets the full rate, then a still one backs off to the slowest
+  CHECK(pingWhenDue(sensor).ok());
+  CHECK(sensor.getPingRate() == 50);
+  for (int i = 0; i < 40; i++)
+  {
+    pingWhenDue(sensor);
+  }
+  CHECK(sensor.getPingInterval() == 200000UL);
+  CHECK(sensor.getPingRate() == 5);
+
+  // Motion snaps back to the full rate
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(90));
+  CHECK(pingWhenDue(sensor).ok());
+  CHECK(sensor.getPingInterval() == 20000UL);
+  for (int i = 0; i < 40; i++)
+  {
+    pingWhenDue(sensor);
+  }
+  CHECK(sensor.getPingInterval() == 200000UL);
+
+  // Pings stopped at a threshold say nothing about motion
+  for (int i = 0; i < 3; i++)
+  {
+    hal::advance(sensor.getPingInterval());
+    CHECK(!sensor.closerThan(MinimalUltrasonic::Threshold(30)));
+  }
+  CHECK(sensor.getPingInterval() == 200000UL);
+
+  // The target vanishes, then comes back at the same distance
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  CHECK(pingWhenDue(sensor).status == MinimalUltrasonic::NO_ECHO);
+  CHECK(sensor.getPingInterval() == 20000UL);
+  pingWhenDue(sensor);
+  CHECK(sensor.getPingInterval() > 20000UL);
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(90));
+  CHECK(pingWhenDue(sensor).ok());
+  CHECK(sensor.getPingInterval() == 20000UL);
+
+  // A close target keeps the full rate even when still
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(10));
+  for (int i = 0; i < 5; i++)
+  {
+    pingWhenDue(sensor);
+  }
+  CHECK(sensor.getPingInterval() == 20000UL);
+
+  // A fixed interval leaves adaptive mode
+  sensor.setPingInterval(0);
+  CHECK(sensor.getPingRate() == 0);
+  CHECK(pingWhenDue(sensor).ok());
+  CHECK(sensor.getPingInterval() == 0);
+}
+
+static void testLastReadingCache()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(20));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+  sensor.setPingInterval(60000UL);
+
+  CHECK(sensor.measure().ok());
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::MM), 200.0, 1.0);
+
+  // readAll() within the interval pings nothing and must not touch the cache
+  MinimalUltrasonic::Distances d;
+  CHECK(sensor.readAll(d).status == MinimalUltrasonic::TOO_SOON);
+  CHECK(d[MinimalUltrasonic::CM] == 0);
+  CHECK(sensor.lastReading().ok());
+  CHECK_NEAR(sensor.lastDistance(), 20.0, 0.1);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::INCHES), 20.0 / 2.54, 0.05);
+
+  // read() and readMicrometers() within the interval report the last ping
+  CHECK_NEAR(sensor.read(), 20.0, 0.1);
+  CHECK_NEAR(sensor.readMicrometers(), 200000.0, 1000.0);
+  CHECK(hal::triggerCount(TRIG) == 1);
+
+  // A new ping replaces every cached unit, including ones filled by readAll()
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(80));
+  hal::advance(60000UL);
+  CHECK(sensor.readAll(d, MinimalUltrasonic::unitBit(MinimalUltrasonic::CM)).ok());
+  CHECK_NEAR(d[MinimalUltrasonic::CM], 80.0, 0.1);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::MM), 800.0, 1.0);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::INCHES), 80.0 / 2.54, 0.05);
+
+  // Switching units back and forth converts afresh each time
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::CM), 80.0, 0.1);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::MM), 800.0, 1.0);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::CM), 80.0, 0.1);
+
+  // Changing the smoothing changes what lastReading() reports
+  sensor.setSmoothing(2);
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(40));
+  hal::advance(60000UL);
+  sensor.measure();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(80));
+  hal::advance(60000UL);
+  sensor.measure();
+  CHECK(sensor.lastDistance(MinimalUltrasonic::CM) < 60.0);
+  sensor.setSmoothing(0);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::CM), 80.0, 0.1);
+
+  // A failed ping clears them
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  hal::advance(60000UL);
+  CHECK(sensor.read(MinimalUltrasonic::MM) == 0);
+  CHECK(sensor.lastDistance(MinimalUltrasonic::INCHES) == 0);
+}
+
+static void testMedian3()
+{
+  hal::reset();
+  MinimalUltrasonic sensor(TRIG, ECHO);
+
+  // A single spike never reaches the output
+  static const float distances[] = {20, 22, 80, 21, 5, 23};
+  static const float medians[] = {20, 20, 22, 22, 21, 21};
+  for (int i = 0; i < 6; i++)
+  {
+    hal::scriptEcho(TRIG, ECHO, 450, widthFor(distances[i]));
+    hal::advance(PING_PERIOD);
+    CHECK_NEAR(sensor.readMedian3(), medians[i], 0.1);
+
+    // The last reading is the median that was returned, not the raw ping
+    CHECK_NEAR(sensor.lastDistance(), medians[i], 0.1);
+    CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::MM), medians[i] * 10, 1.0);
+  }
+
+  // A failed ping reports its status and leaves the history alone
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  hal::advance(PING_PERIOD);
+  CHECK(sensor.measureMedian3().status == MinimalUltrasonic::NO_ECHO);
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(22));
+  hal::advance(PING_PERIOD);
+  CHECK_NEAR(sensor.measureMedian3().distance(), 22.0, 0.1);
+
+  // Within the ping interval it reports the last median, like read()
+  sensor.setPingInterval(PING_PERIOD);
+  unsigned long triggers = hal::triggerCount(TRIG);
+  CHECK_NEAR(sensor.readMedian3(), 22.0, 0.1);
+  CHECK(sensor.measureMedian3().status == MinimalUltrasonic::TOO_SOON);
+  CHECK(hal::triggerCount(TRIG) == triggers);
+
+  // A spike does not reach the moving average either
+  MinimalUltrasonic smoothed(TRIG, ECHO);
+  smoothed.setSmoothing(2);
+  static const float spiky[] = {50, 50, 50, 50, 200, 50, 50};
+  for (int i = 0; i < 7; i++)
+  {
+    hal::scriptEcho(TRIG, ECHO, 450, widthFor(spiky[i]));
+    hal::advance(PING_PERIOD);
+    CHECK_NEAR(smoothed.readMedian3(), 50.0, 0.1);
+    CHECK_NEAR(smoothed.lastDistance(), 50.0, 0.1);
+  }
+  CHECK(MinimalUltrasonic::median3(3, 1, 2) == 2);
+  CHECK(MinimalUltrasonic::median3(7, 7, 1) == 7);
+}
+
+static void testCloserThan()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(100));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+
+  // The wait stops at the threshold instead of running to the echo
+  unsigned long start = hal::now();
+  CHECK(!sensor.closerThan(MinimalUltrasonic::Threshold(30)));
+  CHECK(hal::now() - start < 450 + widthFor(30) + 100);
+  CHECK(sensor.closerThan(MinimalUltrasonic::Threshold(150)));
+
+  // A suppressed ping keeps reporting the obstacle it last saw
+  sensor.setPingInterval(60000UL);
+  unsigned long triggers = hal::triggerCount(TRIG);
+  CHECK(sensor.closerThan(MinimalUltrasonic::Threshold(150)));
+  CHECK(hal::triggerCount(TRIG) == triggers);
+  CHECK(!sensor.closerThan(MinimalUltrasonic::Threshold(50)));
+}
+
+static void testConfidence()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(100));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+
+  // Nothing to agree with at first, then a steady echo earns full trust
+  CHECK(pingLater(sensor).confidence == 191);
+  CHECK(pingLater(sensor).confidence == 255);
+  CHECK(pingLater(sensor).confidence == 255);
+
+  // Pings stopped at a threshold are not dropouts
+  for (int i = 0; i < 4; i++)
+  {
+    hal::advance(PING_PERIOD);
+    CHECK(!sensor.closerThan(MinimalUltrasonic::Threshold(30)));
+  }
+  CHECK(pingLater(sensor).confidence == 255);
+
+  // Real dropouts lower the trust until they leave the 8-ping history
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  CHECK(pingLater(sensor).confidence == 0);
+  CHECK(pingLater(sensor).confidence == 0);
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(100));
+  uint8_t after = pingLater(sensor).confidence;
+  CHECK(after < 255 && after > 191);
+  for (int i = 0; i < 5; i++)
+  {
+    CHECK(pingLater(sensor).confidence == after);
+  }
+  CHECK(pingLater(sensor).confidence < 255);
+  CHECK(pingLater(sensor).confidence == 255);
+}
+
+static void testTracking()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(100));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+  sensor.setTracking(MinimalUltrasonic::Threshold(10), 4);
+
+  CHECK(pingLater(sensor).ok());
+  CHECK(pingLater(sensor).ok());
+
+  // The target jumps away: the gated ping ends just past the window
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(300));
+  hal::advance(PING_PERIOD);
+  unsigned long start = hal::now();
+  CHECK(sensor.measure().status == MinimalUltrasonic::OUT_OF_GATE);
+  CHECK(hal::now() - start < 450 + widthFor(110) + 100);
+
+  // The next ping is full-range and reacquires it
+  CHECK_NEAR(readLater(sensor), 300.0, 0.2);
+
+  // A closer echo is rejected once, then reacquired
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(50));
+  CHECK(pingLater(sensor).status == MinimalUltrasonic::OUT_OF_GATE);
+  CHECK_NEAR(readLater(sensor), 50.0, 0.1);
+}
+
+static void testTrackingConfidence()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(300));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+  sensor.setTracking(MinimalUltrasonic::Threshold(10));
+
+  // An echo in the middle of the gate is no sign of a cut-short echo:
+  // gated and full-range pings of a steady target score the same
+  CHECK(pingLater(sensor).confidence == 191);
+  for (int i = 0; i < 12; i++)
+  {
+    MinimalUltrasonic::Reading r = pingLater(sensor);
+    CHECK(r.ok());
+    CHECK(r.confidence == 255);
+  }
+}
+
+static void testAdaptiveTimeout()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(30));
+  MinimalUltrasonic sensor(TRIG, ECHO, 30000UL);
+  sensor.setAdaptiveTimeout(MinimalUltrasonic::Threshold(10), 8);
+
+  for (int i = 0; i < 4; i++)
+  {
+    CHECK(pingLater(sensor).ok());
+  }
+
+  // Target gone (HC-SR04 holds the echo high): the wait ends near 30 cm * 1.25
+  hal::scriptEcho(TRIG, ECHO, 450, 38000);
+  hal::advance(PING_PERIOD);
+  unsigned long start = hal::now();
+  CHECK(sensor.measure().status == MinimalUltrasonic::OUT_OF_GATE);
+  CHECK(hal::now() - start < 450 + widthFor(40));
+
+  // The periodic probe waits the full timeout and finds a farther target
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(200));
+  bool found = false;
+  for (int i = 0; i < 8 && !found; i++)
+  {
+    found = pingLater(sensor).ok();
+  }
+  CHECK(found);
+  CHECK_NEAR(readLater(sensor), 200.0, 0.2);
+}
+
+static void testCalibration()
+{
+  hal::reset();
+
+  // The sensor reads 5% long plus 40 µs
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(20) * 105 / 100 + 40);
+  MinimalUltrasonic sensor(TRIG, ECHO);
+  unsigned long rawA = sensor.calibrate(20);
+  CHECK(rawA != 0);
+
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(80) * 105 / 100 + 40);
+  unsigned long rawB = sensor.calibrate(80);
+  CHECK(sensor.calibrate(20, rawA, 80, rawB));
+  CHECK_NEAR(sensor.read(), 80.0, 0.1);
+
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(50) * 105 / 100 + 40);
+  CHECK_NEAR(sensor.read(), 50.0, 0.1);
+
+  // Coefficients round-trip, and out-of-range gains are refused
+  MinimalUltrasonic::Calibration c = sensor.getCalibration();
+  sensor.resetCalibration();
+  CHECK(sensor.read() > 52);
+  CHECK(sensor.setCalibration(c));
+  CHECK_NEAR(sensor.read(), 50.0, 0.1);
+
+  MinimalUltrasonic::Calibration bad = {0, 4 * MinimalUltrasonic::CALIBRATION_UNITY};
+  CHECK(!sensor.setCalibration(bad));
+
+  // A plausible gain with an offset beyond Q16 range is refused, not wrapped
+  CHECK(!sensor.calibrate(100000, 1000, 100001, 1058));
+  CHECK(sensor.getCalibration().offset == c.offset && sensor.getCalibration().gain == c.gain);
+}
+
+static void testReadRobust()
+{
+  hal::reset();
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(40));
+  MinimalUltrasonic sensor(TRIG, ECHO);
+
+  uint8_t pings = 0;
+  MinimalUltrasonic::Reading r = sensor.readRobust(2, MinimalUltrasonic::Threshold(1), 5, pings);
+  CHECK(r.ok());
+  CHECK(pings == 2);
+  CHECK_NEAR(r.distance(), 40.0, 0.1);
+
+  // The last reading is the consensus, not the last ping
+  const unsigned long close[] = {widthFor(40), widthFor(41)};
+  EchoSequence pair = {close, 2, 0};
+  hal::onTrigger(TRIG, playSequence, &pair);
+  r = sensor.readRobust(2, MinimalUltrasonic::Threshold(2), 5, pings);
+  CHECK(r.ok());
+  CHECK(sensor.lastReading().duration == r.duration);
+  CHECK_NEAR(sensor.lastDistance(), 40.5, 0.1);
+  CHECK_NEAR(sensor.lastDistance(MinimalUltrasonic::MM), 405.0, 1.0);
+
+  // Failed pings never agree, even when the last one failed
+  hal::scriptEcho(TRIG, ECHO, 450, 0);
+  r = sensor.readRobust(2, MinimalUltrasonic::Threshold(1), 4, pings);
+  CHECK(r.status == MinimalUltrasonic::NO_CONSENSUS);
+  CHECK(r.duration == 0);
+  CHECK(pings == 4);
+
+  // Valid echoes that are all too far apart
+  const unsigned long scattered[] = {widthFor(30), widthFor(40), widthFor(50), widthFor(60)};
+  EchoSequence sequence = {scattered, 4, 0};
+  hal::onTrigger(TRIG, playSequence, &sequence);
+  r = sensor.readRobust(2, MinimalUltrasonic::Threshold(1), 4, pings);
+  CHECK(r.status == MinimalUltrasonic::NO_CONSENSUS);
+  CHECK(r.duration == 0 && r.confidence == 0);
+  CHECK(pings == 4);
+  CHECK(sensor.lastReading().status == MinimalUltrasonic::NO_CONSENSUS);
+  CHECK(sensor.lastDistance() == 0);
+
+  // One echo, then a miss as the last ping
+  const unsigned long lost[] = {widthFor(40), 0};
+  sequence = EchoSequence{lost, 2, 0};
+  r = sensor.readRobust(2, MinimalUltrasonic::Threshold(1), 2, pings);
+  CHECK(r.status == MinimalUltrasonic::NO_CONSENSUS);
+  CHECK(r.duration == 0);
+  CHECK(pings == 2);
+
+  // No pings allowed: nothing is measured and the last reading survives
+  hal::scriptEcho(TRIG, ECHO, 450, widthFor(40));
+  CHECK(sensor.readRobust(1, MinimalUltrasonic::Threshold(1), 1).ok());
+  r = sensor.readRobust(2, MinimalUltrasonic::Threshold(1), 0, pings);
+  CHECK(r.status == MinimalUltrasonic::NO_CONSENSUS);
+  CHECK(pings == 0);
+  CHECK(sensor.lastReading().ok());
+  CHECK_NEAR(sensor.lastDistance(), 40.0, 0.1);
+
+  // Smoothing pulls scattered echoes together, but they still disagree
+  sequence = EchoSequence{scattered, 4, 0};
+  hal::onTrigger(TRIG, playSequence, &sequence);
+  sensor.setSmoothing(4);
+  r = sensor.readRobust(2, MinimalUltrasonic::Threshold(2), 4, pings);
+  CHECK(r.status == MinimalUltrasonic::NO_CONSENSUS);
+  CHECK(pings == 4);
+}
+
+int main()
+{
+  testTrigger();
+  testEcho();
+  testMaxDistance();
+  testSmoothing();
+  testSmoothingCloserThan();
+  testThreePin();
+  testFailures();
+  testPingInterval();
+  testAdaptiveRate();
+  testLastReadingCache();
+  testMedian3();
+  testCloserThan();
+  testConfidence();
+  testTracking();
+  testTrackingConfidence();
+  testAdaptiveTimeout();
+  testCalibration();
+  testReadRobust();
+  return TEST_RESULT();
+}
@@ -0,0 +1,222 @@
+/*
+ * @file test_simulator.cpp
+ * @brief The echo simulator behaves like the scene it describes, reproducibly
+ * @version 2.0.0
+ * @author fermeridamagni (Magni Development)
+ *
+ * @license MIT License
+ */
+
+#include <EchoSimulator.h>
+#include <MinimalUltrasonic.h>
+
+#include "TestCheck.h"
+
+static const unsigned long PING_PERIOD = 60000UL;
+
+/**
+ * @brief Distance the library reports for a true distance at 343 m/s
+ * The library assumes 29.1 µs/cm, the scene 343 m/s (~29.15 µs/cm).
+ */
+static float reported(float cm)
+{
+  return cm * 2e4f / 343.0f / 58.2f;
+}
+
+static float readLater(MinimalUltrasonic &sensor)
+{
+  hal::advance(PING_PERIOD);
+  return sensor.read();
+}
+
+static void testStaticTarget()
+{
+  hal::reset();
+  EchoSimulator scene;
+  scene.addSensor(12, 13);
+  scene.addTarget(150);
+  MinimalUltrasonic sensor(12, 13);
+
+  CHECK_NEAR(readLater(sensor), reported(150), 0.1);
+  CHECK(scene.pings(0) == 1);
+}
+
+static void testSeed()
+{
+  float first[50];
+  for (int run = 0; run < 3; run++)
+  {
+    hal::reset();
+    EchoSimulator scene(run < 2 ? 7 : 8);
+    scene.addSensor(12, 13);
+    scene.addTarget(120, 0, 0, 0.5);
+    scene.setNoise(20);
+    scene.setDropout(0.1);
+    MinimalUltrasonic sensor(12, 13);
+
+    int same = 0;
+    for (int i = 0; i < 50; i++)
+    {
+      float cm = readLater(sensor);
+      if (run == 0)
+      {
+        first[i] = cm;
+      }
+      same += (cm == first[i]);
+    }
+    CHECK(run == 2 ? same < 50 : same == 50);
+  }
+}
+
+static void testNoiseAndDropout()
+{
+  hal::reset();
+  EchoSimulator scene(3);
+  scene.addSensor(12, 13);
+  scene.addTarget(100);
+  scene.setNoise(10);
+  scene.setDropout(0.25);
+  MinimalUltrasonic sensor(12, 13);
+
+  int failed = 0;
+  double sum = 0;
+  for (int i = 0; i < 2000; i++)
+  {
+    float cm = readLater(sensor);
+    if (cm == 0)
+    {
+      failed++;
+    }
+    sum += cm;
+  }
+  CHECK_NEAR(failed / 2000.0, 0.25, 0.03);
+  CHECK_NEAR(sum / (2000 - failed), reported(100), 0.1);
+}
+
+static void testConfidence()
+{
+  // Mean confidence of the valid readings: a noisy, flaky echo earns less
+  double mean[2];
+  for (int noisy = 0; noisy < 2; noisy++)
+  {
+    hal::reset();
+    EchoSimulator scene(5);
+    scene.addSensor(12, 13);
+    scene.addTarget(100);
+    if (noisy)
+    {
+      scene.setNoise(40);
+      scene.setDropout(0.2);
+    }
+    MinimalUltrasonic sensor(12, 13);
+
+    unsigned long sum = 0;
+    int valid = 0;
+    for (int i = 0; i < 500; i++)
+    {
+      hal::advance(PING_PERIOD);
+      MinimalUltrasonic::Reading r = sensor.measure();
+      CHECK(r.ok() || r.confidence == 0);
+      if (r.ok())
+      {
+        sum += r.confidence;
+        valid++;
+      }
+    }
+    mean[noisy] = (double)sum / valid;
+  }
+  CHECK(mean[0] > 250);
+  CHECK(mean[1] < 230);
+}
+
+static void testBeamAndRange()
+{
+  hal::reset();
+  EchoSimulator scene;
+  scene.addSensor(12, 13, 0);
+  scene.addSensor(10, 11, 40);
+  scene.addTarget(80, 0, 40);
+  MinimalUltrasonic ahead(12, 13);
+  MinimalUltrasonic side(10, 11);
+
+  CHECK(readLater(ahead) == 0);
+  CHECK_NEAR(readLater(side), reported(80), 0.1);
+
+  // A soft target fades out sooner than a wall
+  scene.target(0).distance = 300;
+  scene.target(0).reflectivity = 0.25;
+  CHECK(readLater(side) == 0);
+  scene.target(0).reflectivity = 1;
+  CHECK_NEAR(readLater(side), reported(300), 0.2);
+}
+
+static void testMotion()
+{
+  hal::reset();
+  EchoSimulator scene;
+  scene.addSensor(12, 13);
+  scene.addTarget(200, -50);
+  MinimalUltrasonic sensor(12, 13);
+
+  for (int i = 0; i < 20; i++)
+  {
+    hal::advance(PING_PERIOD);
+    float expected = reported(scene.distanceAt(0, hal::now()));
+    CHECK_NEAR(sensor.read(), expected, 0.2);
+  }
+}
+
+static void testMultipath()
+{
+  hal::reset();
+  EchoSimulator scene;
+  scene.addSensor(12, 13);
+  scene.addTarget(100);
+  scene.setMultipath(1);
+  MinimalUltrasonic sensor(12, 13);
+
+  CHECK_NEAR(readLater(sensor), reported(200), 0.2);
+}
+
+static void testCrosstalk()
+{
+  for (int coupled = 0; coupled < 2; coupled++)
+  {
+    hal::reset();
+    EchoSimulator scene;
+    scene.addSensor(12, 13);
+    scene.addSensor(10, 11);
+    scene.addTarget(300);
+    scene.setCrosstalk(coupled);
+
+    // A gives up early, B pings right away while A's echo is in flight
+    MinimalUltrasonic a(12, 13);
+    MinimalUltrasonic b(10, 11);
+    a.setMaxDistance(100);
+    hal::advance(PING_PERIOD);
+    CHECK(a.read() == 0);
+    float cm = b.read();
+
+    if (coupled)
+    {
+      CHECK(cm < 250);
+    }
+    else
+    {
+      CHECK_NEAR(cm, reported(300), 0.2);
+    }
+  }
+}
+
+int main()
+{
+  testStaticTarget();
+  testSeed();
+  testNoiseAndDropout();
+  testConfidence();
+  testBeamAndRange();
+  testMotion();
+  testMultipath();
+  testCrosstalk();
+  return TEST_RESULT();
+}
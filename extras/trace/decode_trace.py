@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""Turn MinimalUltrasonic::dumpTrace() output into CSV.
+
+The input may be a raw capture of a serial port: text printed around the
+dumps is skipped, and every dump found is decoded. Dumps with a bad
+checksum are reported on stderr and skipped.
+
+    decode_trace.py capture.bin > trace.csv
+    cat /dev/ttyACM0 | decode_trace.py
+
+Columns: dump (0 for the first dump in the input), ping (0 for the oldest),
+trigger_us (micros() at the end of the trigger pulse), rise_us and fall_us
+(echo edges relative to the trigger, empty when not seen), width_us and
+status.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+MAGIC = b"MUT"
+VERSION = 1
+PING = struct.Struct("<IHHB")
+
+STATUS_NAMES = {
+    0: "OK",
+    1: "NO_ECHO",
+    2: "STUCK_HIGH",
+    3: "OUT_OF_GATE",
+    4: "TOO_SOON",
+    5: "NO_CONSENSUS",
+}
+
+
+def find_dumps(data):
+    """Yield the list of (trigger, rise, fall, status) of every valid dump."""
+    start = data.find(MAGIC)
+    while start != -1:
+        header = data[start:start + 5]
+        if len(header) == 5 and header[3] == VERSION:
+            count = header[4]
+            end = start + 5 + count * PING.size
+            if end < len(data):
+                check = 0
+                for byte in data[start:end]:
+                    check ^= byte
+                if check == data[end]:
+                    yield [PING.unpack_from(data, start + 5 + i * PING.size) for i in range(count)]
+                    start = data.find(MAGIC, end + 1)
+                    continue
+                print("decode_trace: bad checksum at byte %d, skipped" % start, file=sys.stderr)
+            else:
+                print("decode_trace: truncated dump at byte %d" % start, file=sys.stderr)
+        start = data.find(MAGIC, start + 1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", help="binary capture (default: stdin)")
+    parser.add_argument("-o", "--output", help="CSV file (default: stdout)")
+    args = parser.parse_args()
+
+    if args.input:
+        with open(args.input, "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.writer(out, lineterminator="\n")
+    writer.writerow(["dump", "ping", "trigger_us", "rise_us", "fall_us", "width_us", "status"])
+
+    dumps = 0
+    for pings in find_dumps(data):
+        for index, (trigger, rise, fall, status) in enumerate(pings):
+            writer.writerow([
+                dumps,
+                index,
+                trigger,
+                rise if rise else "",
+                fall if fall else "",
+                fall - rise if fall else "",
+                STATUS_NAMES.get(status, status),
+            ])
+        dumps += 1
+
+    if out is not sys.stdout:
+        out.close()
+    if dumps == 0:
+        print("decode_trace: no dump found", file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -14,6 +14,11 @@
 
 #include "MinimalUltrasonic.h"
 
+static_assert(sizeof(MinimalUltrasonic::Reading) <= 8, "Reading must fit in 8 bytes");
+#if MINIMAL_ULTRASONIC_TRACE
+static_assert(MINIMAL_ULTRASONIC_TRACE <= 255, "MINIMAL_ULTRASONIC_TRACE must be at most 255");
+#endif
+
 // ===========================
 // Physical Constants
 // ===========================
@@ -26,6 +31,136 @@
  */
 static const float MICROSECONDS_PER_CM = 29.1;
 
+/**
+ * @brief Round-trip time per centimeter in tenths of a microsecond
+ * Integer form of 2 * MICROSECONDS_PER_CM for setMaxDistance(unsigned int).
+ */
+static const unsigned long ROUND_TRIP_DECI_US_PER_CM = 582UL;
+
+/**
+ * @brief Micrometers per microsecond of round trip, split for fixed point
+ * 10000 µm/cm / (2 * 29.1 µs/cm) = 171.8213058...
+ * Integer part 171, fraction 0.8213058... = 53825 / 2^16 + 6531 / 2^32.
+ * The second fraction word keeps the error below 0.01 µm over the full range.
+ */
+static const uint32_t MICROMETERS_PER_US_INT = 171UL;
+static const uint32_t MICROMETERS_PER_US_FRAC_HI = 53825UL;
+static const uint32_t MICROMETERS_PER_US_FRAC_LO = 6531UL;
+
+/**
+ * @brief Pause between calibration pings in milliseconds
+ * The HC-SR04 datasheet recommends a measurement cycle of at least 60ms
+ * so that echoes of the previous ping have died out.
+ */
+static const unsigned long CALIBRATION_PING_DELAY_MS = 60;
+
+/**
+ * @brief Pause between the pings of readRobust()
+ * Long enough for echoes of the previous ping to fade at typical ranges.
+ */
+static const unsigned long ROBUST_PING_DELAY_MS = 20;
+
+/**
+ * @brief Most pings readRobust() keeps (one uint16_t of stack each)
+ */
+static const uint8_t ROBUST_MAX_PINGS = 16;
+
+/**
+ * @brief Version byte of the dumpTrace() format
+ */
+static const uint8_t TRACE_FORMAT_VERSION = 1;
+
+/**
+ * @brief Accepted calibration gain range in Q16 (0.5 to 2.0, exclusive)
+ */
+static const uint32_t CALIBRATION_MIN_GAIN = 0x8000UL;
+static const uint32_t CALIBRATION_MAX_GAIN = 0x20000UL;
+
+/**
+ * @brief Largest Q16 offset magnitude, as a float that converts to int32_t
+ * 2^31 - 128 is the largest float below 2^31.
+ */
+static const float CALIBRATION_MAX_OFFSET = 2147483520.0f;
+
+/**
+ * @brief Largest raw duration handled by the calibration arithmetic
+ */
+static const unsigned long CALIBRATION_MAX_RAW = 0xFFFFUL;
+
+/**
+ * @brief Confidence scoring parameters
+ * A reading agrees with recent ones when it is within 1/16 (~6%) of their
+ * average plus a fixed 30 µs (~0.5 cm) of jitter allowance. Echoes in the
+ * last 1/8 of the timeout are penalised since they may be cut short, and
+ * each failure among the last 8 pings costs 24/256 of the score.
+ */
+static const uint16_t CONFIDENCE_TOLERANCE_US = 30;
+static const uint8_t CONFIDENCE_TOLERANCE_SHIFT = 4;
+static const uint8_t CONFIDENCE_EDGE_SHIFT = 3;
+static const uint8_t CONFIDENCE_DROPOUT_PENALTY = 24;
+static const uint8_t CONFIDENCE_NO_HISTORY = 192;
+
+// ===========================
+// Helpers
+// ===========================
+
+/**
+ * @brief Scale a score by num / den (num < den) without dividing
+ *
+ * Halves the score once per factor of two between num and den, then
+ * applies the remaining ratio, which lies in (1/2, 1), rounded down to
+ * eighths. A few shifts and compares instead of a 32-bit division, which
+ * costs several hundred cycles on AVR. Needs den < 2^29.
+ */
+static uint16_t scaleDown(uint16_t score, uint32_t num, uint32_t den)
+{
+  if (num >= den)
+  {
+    return score;
+  }
+  if (num == 0)
+  {
+    return 0;
+  }
+
+  while ((num << 1) < den)
+  {
+    num <<= 1;
+    score >>= 1;
+  }
+
+  // num / den is now in [1/2, 1): find the largest eighth not above it
+  uint32_t num8 = num << 3;
+  uint32_t threshold = den << 2;
+  uint8_t eighths = 4;
+  while (eighths < 7 && num8 >= threshold + den)
+  {
+    threshold += den;
+    eighths++;
+  }
+
+  return (score * eighths) >> 3;
+}
+
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM
+/**
+ * @brief Count a phase duration in its log2 bucket, saturating at 65535
+ */
+static void addToHistogram(uint16_t *buckets, unsigned long us)
+{
+  uint8_t bucket = 0;
+  while (us != 0 && bucket < MinimalUltrasonic::HISTOGRAM_BUCKETS - 1)
+  {
+    us >>= 1;
+    bucket++;
+  }
+  if (buckets[bucket] != 0xFFFF)
+  {
+    buckets[bucket]++;
+  }
+}
+#endif
+
 // ===========================
 // Constructors
 // ===========================
@@ -40,9 +175,44 @@ MinimalUltrasonic::MinimalUltrasonic(uint8_t trigPin, uint8_t echoPin, unsigned
     : _trigPin(trigPin),
       _echoPin(echoPin),
       _isThreePin(trigPin == echoPin),
+      _hasPinged(false),
       _timeout(timeOut),
-      _defaultUnit(CM)
+      _minWidth(0),
+      _pingInterval(0),
+      _adaptiveMin(0),
+      _adaptiveMax(0),
+      _adaptiveMotion(0),
+      _adaptiveAlert(0),
+      _adaptiveLast(0),
+      _trackWindow(0),
+      _trackCenter(0),
+      _trackEvery(0),
+      _trackCount(0),
+      _timeoutFloor(0),
+      _timeoutQuantile(0),
+      _probeEvery(0),
+      _probeCount(0),
+      _last{0, 0, TOO_SOON, 0},
+      _defaultUnit(CM),
+      _smoothing(0),
+      _ema(0),
+      _history{0, 0},
+      _recent(0),
+      _jitter(0),
+      _outcomes(0),
+      _calibration{0, CALIBRATION_UNITY}
 {
+  _cached = 0;
+#if MINIMAL_ULTRASONIC_STATS
+  resetStats();
+#endif
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM
+  resetTimingHistogram();
+#endif
+#if MINIMAL_ULTRASONIC_TRACE
+  clearTrace();
+#endif
+
   // Initialize pins
   pinMode(_trigPin, OUTPUT);
   pinMode(_echoPin, INPUT);
@@ -57,15 +227,394 @@ MinimalUltrasonic::MinimalUltrasonic(uint8_t trigPin, uint8_t echoPin, unsigned
 
 float MinimalUltrasonic::read(Unit unit) const
 {
-  unsigned long duration = timing();
+  smooth(ping(_timeout));
+  return lastDistance(unit);
+}
+
+uint32_t MinimalUltrasonic::readMicrometers() const
+{
+  // Like read(), a ping suppressed by the interval reports the last one
+  smooth(ping(_timeout));
+  return lastReading().micrometers();
+}
+
+MinimalUltrasonic::Reading MinimalUltrasonic::measure()
+{
+  return smooth(ping(_timeout));
+}
+
+bool MinimalUltrasonic::closerThan(const Threshold &threshold)
+{
+  // Stop waiting as soon as the echo is longer than the threshold
+  unsigned long limit = removeCalibration(threshold.duration);
+  if (limit > _timeout)
+  {
+    limit = _timeout;
+  }
+
+  // Suppressed by the ping interval: nothing was measured, so answer from
+  // the last measurement instead of reporting a clear path
+  Reading reading = ping(limit);
+  if (reading.status == TOO_SOON)
+  {
+    return _last.closerThan(threshold);
+  }
+
+  // Compare the echo itself: a smoothed value lags behind an obstacle that
+  // just appeared. The average still takes the echo, for lastDistance()
+  smooth(reading);
+  return reading.closerThan(threshold);
+}
+
+float MinimalUltrasonic::readMedian3(Unit unit)
+{
+  // Like read(), a ping suppressed by the interval reports the last one
+  measureMedian3();
+  return lastDistance(unit);
+}
+
+MinimalUltrasonic::Reading MinimalUltrasonic::measureMedian3()
+{
+  // The median works on the echoes themselves, so a spike never enters
+  // the moving average; only the median is smoothed
+  Reading reading = ping(_timeout);
+  if (!reading.ok())
+  {
+    return reading;
+  }
+
+  // Until two samples are known, the missing ones repeat the first
+  uint16_t duration = reading.duration;
+  if (_history[0] == 0)
+  {
+    _history[0] = duration;
+    _history[1] = duration;
+  }
+
+  reading.duration = median3(_history[0], _history[1], duration);
+  _history[0] = _history[1];
+  _history[1] = duration;
+
+  // Report the median, not the raw ping, through lastReading()/lastDistance()
+  _last = reading;
+  _cached = 0;
+
+  return smooth(reading);
+}
+
+MinimalUltrasonic::Reading MinimalUltrasonic::readRobust(uint8_t k, const Threshold &tolerance,
+                                                        uint8_t maxPings, uint8_t &pings)
+{
+  if (maxPings > ROBUST_MAX_PINGS)
+  {
+    maxPings = ROBUST_MAX_PINGS;
+  }
+  if (k > maxPings)
+  {
+    k = maxPings;
+  }
+  if (k == 0)
+  {
+    k = 1;
+  }
+
+  uint16_t samples[ROBUST_MAX_PINGS];
+  uint8_t valid = 0;
+  bool agreed = false;
+  Reading reading = {0, 0, NO_CONSENSUS, 0};
+
+  pings = 0;
+  while (pings < maxPings)
+  {
+    if (pings != 0)
+    {
+      delay(ROBUST_PING_DELAY_MS);
+    }
+
+    // Wait out the ping interval instead of spending a ping on TOO_SOON.
+    // Agreement is judged on the echoes themselves: smoothed durations are
+    // pulled together and would agree too easily
+    do
+    {
+      reading = ping(_timeout);
+    } while (reading.status == TOO_SOON);
+    pings++;
+
+    if (!reading.ok())
+    {
+      continue;
+    }
+
+    // A set of agreeing echoes is complete when its last member arrives,
+    // so it is enough to count the echoes within tolerance of the newest
+    uint16_t duration = reading.duration;
+    samples[valid++] = duration;
+
+    uint8_t agree = 0;
+    unsigned long sum = 0;
+    for (uint8_t i = 0; i < valid; i++)
+    {
+      uint16_t spread = (samples[i] > duration) ? samples[i] - duration : duration - samples[i];
+      if (spread <= tolerance.duration)
+      {
+        agree++;
+        sum += samples[i];
+      }
+    }
+
+    if (agree >= k)
+    {
+      reading.duration = (uint16_t)((sum + agree / 2) / agree);
+      agreed = true;
+      break;
+    }
+  }
+
+  // Not a single ping (maxPings == 0): keep the last reading as it is
+  if (pings == 0)
+  {
+    return reading;
+  }
+
+  // Whether the last ping failed or merely disagreed, there is no answer
+  if (!agreed)
+  {
+    reading.status = NO_CONSENSUS;
+    reading.duration = 0;
+    reading.confidence = 0;
+  }
+
+  // Report the result, not the last ping, through lastReading()/lastDistance()
+  _last = reading;
+  _cached = 0;
+
+  // Only the result enters the moving average
+  return smooth(reading);
+}
+
+MinimalUltrasonic::Reading MinimalUltrasonic::readRobust(uint8_t k, const Threshold &tolerance,
+                                                        uint8_t maxPings)
+{
+  uint8_t pings;
+  return readRobust(k, tolerance, maxPings, pings);
+}
+
+MinimalUltrasonic::Reading MinimalUltrasonic::readAll(Distances &distances, uint8_t units)
+{
+  Reading reading = measure();
+
+  // One centimeter value, then one scaling per requested unit
+  float distanceCm = reading.distance(CM);
+  for (uint8_t unit = 0; unit < UNIT_COUNT; unit++)
+  {
+    if (units & unitBit((Unit)unit))
+    {
+      distances.value[unit] = convertFromCm(distanceCm, (Unit)unit);
+
+#if MINIMAL_ULTRASONIC_UNIT_CACHE
+      // Keep the values for lastDistance() as well, unless no ping was
+      // fired: then _last and its cache still describe the previous one
+      if (reading.status != TOO_SOON)
+      {
+        _cache[unit] = distances.value[unit];
+        _cached |= unitBit((Unit)unit);
+      }
+#endif
+    }
+    else
+    {
+      distances.value[unit] = 0.0;
+    }
+  }
+
+  return reading;
+}
+
+MinimalUltrasonic::Reading MinimalUltrasonic::ping(unsigned long maxWidth) const
+{
+  Reading reading;
+  reading.timestamp = micros();
+  reading.duration = 0;
+  reading.confidence = 0;
+
+  // Leave the sensor alone until echoes of the previous ping have died out
+  if (_hasPinged && _pingInterval != 0 && (reading.timestamp - _last.timestamp) < _pingInterval)
+  {
+    reading.status = TOO_SOON;
+    return reading;
+  }
+  _hasPinged = true;
+
+  // Which limit ends the wait early: the caller's threshold, unless the
+  // adaptive timeout or the tracking gate below is shorter still
+  bool thresholdBound = maxWidth < _timeout;
+  bool gateBound = false;
+
+  // Adaptive timeout: wait just past the usual echoes, except when probing
+  bool probe = _probeEvery != 0 && (_probeCount == 0 || _timeoutQuantile == 0);
+  if (_probeEvery != 0 && !probe)
+  {
+    unsigned long limit = removeCalibration((unsigned long)_timeoutQuantile +
+                                            (_timeoutQuantile >> 2));
+    if (limit < _timeoutFloor)
+    {
+      limit = _timeoutFloor;
+    }
+    if (limit < maxWidth)
+    {
+      maxWidth = limit;
+      thresholdBound = false;
+    }
+  }
 
-  // If timeout occurred, return 0
-  if (duration == 0)
+  // Tracking: stop waiting once the echo runs past the expected window
+  bool gated = _trackWindow != 0 && _trackCount != 0;
+  if (gated)
+  {
+    unsigned long upper = removeCalibration((unsigned long)_trackCenter + _trackWindow);
+    if (upper < maxWidth)
+    {
+      maxWidth = upper;
+      thresholdBound = false;
+      gateBound = true;
+    }
+  }
+
+  unsigned long raw;
+  reading.status = timing(raw, maxWidth);
+
+  // Stopped at one of the limits above: the target is merely beyond it,
+  // which is neither a dropout nor a vanished target
+  bool shortened = reading.status == OUT_OF_GATE;
+#if MINIMAL_ULTRASONIC_STATS
+  unsigned long blocked = micros() - reading.timestamp;
+#endif
+  if (reading.status == OK)
+  {
+    unsigned long duration = applyCalibration(raw);
+
+    // Reject echoes inside the configured minimum distance, or ending
+    // before the tracking window (crosstalk or a sudden new target), and
+    // echoes too long for the calibration or the 16-bit Reading (~11 m)
+    if (duration < _minWidth ||
+        (gated && duration + _trackWindow < _trackCenter) ||
+        raw > CALIBRATION_MAX_RAW || duration > 0xFFFFUL)
+    {
+      reading.status = OUT_OF_GATE;
+    }
+
+    reading.duration = (duration > 0xFFFFUL) ? 0xFFFF : (uint16_t)duration;
+  }
+
+#if MINIMAL_ULTRASONIC_STATS
+  count(reading.status, shortened, raw, blocked);
+#endif
+#if MINIMAL_ULTRASONIC_TRACE
+  // timing() just recorded this ping; keep the status after the gates
+  _trace[(_traceNext ? _traceNext : MINIMAL_ULTRASONIC_TRACE) - 1].status = reading.status;
+#endif
+
+  // Only a miss of its own gate tells the tracker the target is lost
+  if (_trackWindow != 0 && (!shortened || gateBound))
+  {
+    track(reading);
+  }
+
+  // A ping cut by the caller's threshold did not run on the adaptive timeout
+  if (_probeEvery != 0 && !(shortened && thresholdBound))
+  {
+    adaptTimeout(reading, probe);
+  }
+
+  if (!shortened)
+  {
+    reading.confidence = rate(reading.status, reading.duration, raw);
+  }
+
+  if (_adaptiveMax != 0 && !shortened)
+  {
+    adaptInterval(reading);
+  }
+
+  // New measurement: previously converted values are stale
+  _last = reading;
+  _cached = 0;
+
+  return reading;
+}
+
+MinimalUltrasonic::Reading MinimalUltrasonic::smooth(Reading reading) const
+{
+  if (reading.ok() && _smoothing != 0)
+  {
+    reading.duration = applySmoothing(reading.duration);
+  }
+  return reading;
+}
+
+MinimalUltrasonic::Reading MinimalUltrasonic::lastReading() const
+{
+  // _last keeps the echo itself; report it through the average like measure()
+  Reading reading = _last;
+  if (reading.ok() && _smoothing != 0 && _ema != 0)
+  {
+    reading.duration = smoothedDuration();
+  }
+  return reading;
+}
+
+float MinimalUltrasonic::lastDistance(Unit unit) const
+{
+  if (!_last.ok())
   {
     return 0.0;
   }
 
-  return convertToUnit(duration, unit);
+#if MINIMAL_ULTRASONIC_UNIT_CACHE
+  // Unknown units fall back to centimeters in convertToUnit(), uncached
+  if (unit >= UNIT_COUNT)
+  {
+    return convertToUnit(lastReading().duration, unit);
+  }
+
+  // Convert on first access only, until the next ping
+  if (!(_cached & unitBit(unit)))
+  {
+    _cache[unit] = convertToUnit(lastReading().duration, unit);
+    _cached |= unitBit(unit);
+  }
+
+  return _cache[unit];
+#else
+  // Only the unit asked for last is kept
+  if (unit >= UNIT_COUNT)
+  {
+    return convertToUnit(lastReading().duration, unit);
+  }
+
+  if (_cached != unit + 1)
+  {
+    _cache[0] = convertToUnit(lastReading().duration, unit);
+    _cached = unit + 1;
+  }
+
+  return _cache[0];
+#endif
+}
+
+MinimalUltrasonic::Threshold::Threshold(float distance, Unit unit)
+    : duration(toMicroseconds(distance, unit))
+{
+}
+
+float MinimalUltrasonic::Reading::distance(Unit unit) const
+{
+  return ok() ? convertToUnit(duration, unit) : 0.0;
+}
+
+uint32_t MinimalUltrasonic::Reading::micrometers() const
+{
+  return ok() ? toMicrometers(duration) : 0;
 }
 
 void MinimalUltrasonic::setTimeout(unsigned long timeOut)
@@ -75,9 +624,92 @@ void MinimalUltrasonic::setTimeout(unsigned long timeOut)
 
 void MinimalUltrasonic::setMaxDistance(unsigned int distance)
 {
-  // Calculate timeout based on distance in cm
+  // Calculate timeout based on distance in cm, in integer arithmetic
   // Time = Distance * 2 (round trip) * microseconds per cm
-  _timeout = distance * 2 * MICROSECONDS_PER_CM;
+  if (distance > (0xFFFFFFFFUL - 5) / ROUND_TRIP_DECI_US_PER_CM)
+  {
+    _timeout = 0xFFFFFFFFUL;
+    return;
+  }
+  _timeout = ((unsigned long)distance * ROUND_TRIP_DECI_US_PER_CM + 5) / 10;
+}
+
+void MinimalUltrasonic::setMaxDistance(float distance, Unit unit)
+{
+  _timeout = toMicroseconds(distance, unit);
+}
+
+void MinimalUltrasonic::setMinDistance(float distance, Unit unit)
+{
+  _minWidth = toMicroseconds(distance, unit);
+}
+
+void MinimalUltrasonic::setAdaptiveTimeout(const Threshold &minimum, uint8_t probeEvery)
+{
+  _timeoutFloor = minimum.duration;
+  _timeoutQuantile = 0;
+  _probeEvery = probeEvery;
+  _probeCount = 0;
+}
+
+void MinimalUltrasonic::setPingInterval(unsigned long interval)
+{
+  _pingInterval = interval;
+  _adaptiveMax = 0;
+}
+
+unsigned long MinimalUltrasonic::getPingInterval() const
+{
+  return _pingInterval;
+}
+
+void MinimalUltrasonic::setAdaptiveRate(unsigned long minInterval, unsigned long maxInterval,
+                                        const Threshold &motion, const Threshold &alert)
+{
+  if (maxInterval < minInterval)
+  {
+    maxInterval = minInterval;
+  }
+
+  _adaptiveMin = minInterval;
+  _adaptiveMax = (maxInterval != 0) ? maxInterval : 1;
+  _adaptiveMotion = (motion.duration > 0xFFFFUL) ? 0xFFFF : (uint16_t)motion.duration;
+  _adaptiveAlert = (alert.duration > 0xFFFFUL) ? 0xFFFF : (uint16_t)alert.duration;
+  _adaptiveLast = 0;
+
+  // Start fast until the scene is known to be quiet
+  _pingInterval = minInterval;
+}
+
+void MinimalUltrasonic::setTracking(const Threshold &window, uint8_t reacquireEvery)
+{
+  _trackWindow = (window.duration > 0xFFFFUL) ? 0xFFFF : (uint16_t)window.duration;
+  _trackEvery = (reacquireEvery != 0) ? reacquireEvery : 1;
+  _trackCount = 0;
+}
+
+uint16_t MinimalUltrasonic::getPingRate() const
+{
+  if (_pingInterval == 0)
+  {
+    return 0;
+  }
+
+  unsigned long rate = 1000000UL / _pingInterval;
+  return (rate > 0xFFFFUL) ? 0xFFFF : (uint16_t)rate;
+}
+
+void MinimalUltrasonic::setSmoothing(uint8_t shift)
+{
+  // 15 keeps the accumulator (65535 << 15) within 32 bits
+  _smoothing = (shift > 15) ? 15 : shift;
+  _ema = 0;
+  _cached = 0; // lastReading() now reports the echo unsmoothed
+}
+
+uint8_t MinimalUltrasonic::getSmoothing() const
+{
+  return _smoothing;
 }
 
 unsigned long MinimalUltrasonic::getTimeout() const
@@ -95,12 +727,211 @@ void MinimalUltrasonic::setUnit(Unit unit)
   _defaultUnit = unit;
 }
 
+unsigned long MinimalUltrasonic::calibrate(float knownDistance, uint8_t samples, Unit unit)
+{
+  if (samples == 0)
+  {
+    return 0;
+  }
+
+  // Average raw pings, tolerating some dropouts but never looping forever
+  unsigned long sum = 0;
+  uint8_t valid = 0;
+  for (uint16_t attempt = 0; attempt < 2U * samples && valid < samples; attempt++)
+  {
+    unsigned long raw;
+    if (timing(raw, _timeout) == OK)
+    {
+      sum += (raw > CALIBRATION_MAX_RAW) ? CALIBRATION_MAX_RAW : raw;
+      valid++;
+    }
+    delay(CALIBRATION_PING_DELAY_MS);
+  }
+
+  if (valid == 0)
+  {
+    return 0;
+  }
+
+  unsigned long mean = (sum + valid / 2) / valid;
+
+  // Keep the gain, move the offset so that the mean lands on the expected time
+  float expected = toMicroseconds(knownDistance, unit);
+  float offset = expected * CALIBRATION_UNITY - (float)mean * _calibration.gain;
+  if (offset > CALIBRATION_MAX_OFFSET)
+  {
+    offset = CALIBRATION_MAX_OFFSET;
+  }
+  else if (offset < -CALIBRATION_MAX_OFFSET)
+  {
+    offset = -CALIBRATION_MAX_OFFSET;
+  }
+  _calibration.offset = (int32_t)offset;
+
+  return mean;
+}
+
+bool MinimalUltrasonic::calibrate(float distanceA, unsigned long rawA, float distanceB, unsigned long rawB, Unit unit)
+{
+  if (rawA == rawB || rawA == 0 || rawB == 0)
+  {
+    return false;
+  }
+
+  float expectedA = toMicroseconds(distanceA, unit);
+  float expectedB = toMicroseconds(distanceB, unit);
+
+  // Straight line through both points: expected = raw * gain + offset
+  float gain = (expectedB - expectedA) / ((float)rawB - (float)rawA);
+  float offset = expectedA - (float)rawA * gain;
+
+  // Check the range before converting: a float outside the integer range
+  // has no defined conversion (written so that NaN fails as well)
+  float gainQ16 = gain * CALIBRATION_UNITY + 0.5f;
+  float offsetQ16 = offset * CALIBRATION_UNITY;
+  if (!(gainQ16 >= CALIBRATION_MIN_GAIN && gainQ16 < CALIBRATION_MAX_GAIN) ||
+      !(offsetQ16 >= -CALIBRATION_MAX_OFFSET && offsetQ16 <= CALIBRATION_MAX_OFFSET))
+  {
+    return false;
+  }
+
+  Calibration fitted;
+  fitted.gain = (uint32_t)gainQ16;
+  fitted.offset = (int32_t)offsetQ16;
+  return setCalibration(fitted);
+}
+
+MinimalUltrasonic::Calibration MinimalUltrasonic::getCalibration() const
+{
+  return _calibration;
+}
+
+bool MinimalUltrasonic::setCalibration(const Calibration &calibration)
+{
+  if (calibration.gain < CALIBRATION_MIN_GAIN || calibration.gain >= CALIBRATION_MAX_GAIN)
+  {
+    return false;
+  }
+
+  _calibration = calibration;
+  return true;
+}
+
+void MinimalUltrasonic::resetCalibration()
+{
+  _calibration.offset = 0;
+  _calibration.gain = CALIBRATION_UNITY;
+}
+
+#if MINIMAL_ULTRASONIC_STATS
+const MinimalUltrasonic::Stats &MinimalUltrasonic::getStats() const
+{
+  return _stats;
+}
+
+void MinimalUltrasonic::resetStats()
+{
+  _stats = Stats{0, 0, 0, 0, 0, 0, 0xFFFF, 0, 0};
+}
+#endif
+
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM
+const MinimalUltrasonic::TimingHistogram &MinimalUltrasonic::getTimingHistogram() const
+{
+  return _histogram;
+}
+
+void MinimalUltrasonic::printTimingHistogram(Print &out) const
+{
+  out.println("us\ttrigger\trise\tpulse");
+  for (uint8_t bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++)
+  {
+    out.print(bucket ? (1UL << (bucket - 1)) : 0UL);
+    out.print('\t');
+    out.print((unsigned long)_histogram.trigger[bucket]);
+    out.print('\t');
+    out.print((unsigned long)_histogram.rise[bucket]);
+    out.print('\t');
+    out.println((unsigned long)_histogram.pulse[bucket]);
+  }
+}
+
+void MinimalUltrasonic::resetTimingHistogram()
+{
+  memset(&_histogram, 0, sizeof(_histogram));
+}
+#endif
+
+#if MINIMAL_ULTRASONIC_TRACE
+uint8_t MinimalUltrasonic::traceLength() const
+{
+  return _traceLength;
+}
+
+const MinimalUltrasonic::TraceEntry &MinimalUltrasonic::getTrace(uint8_t index) const
+{
+  // The oldest entry is the one about to be overwritten once the ring is full
+  uint16_t slot = index;
+  if (_traceLength == MINIMAL_ULTRASONIC_TRACE)
+  {
+    slot += _traceNext;
+  }
+  return _trace[slot % MINIMAL_ULTRASONIC_TRACE];
+}
+
+void MinimalUltrasonic::dumpTrace(Print &out) const
+{
+  uint8_t bytes[9] = {'M', 'U', 'T', TRACE_FORMAT_VERSION, _traceLength};
+  uint8_t check = 0;
+  for (uint8_t i = 0; i < 5; i++)
+  {
+    out.write(bytes[i]);
+    check ^= bytes[i];
+  }
+
+  for (uint8_t i = 0; i < _traceLength; i++)
+  {
+    const TraceEntry &entry = getTrace(i);
+    bytes[0] = (uint8_t)entry.trigger;
+    bytes[1] = (uint8_t)(entry.trigger >> 8);
+    bytes[2] = (uint8_t)(entry.trigger >> 16);
+    bytes[3] = (uint8_t)(entry.trigger >> 24);
+    bytes[4] = (uint8_t)entry.rise;
+    bytes[5] = (uint8_t)(entry.rise >> 8);
+    bytes[6] = (uint8_t)entry.fall;
+    bytes[7] = (uint8_t)(entry.fall >> 8);
+    bytes[8] = entry.status;
+    for (uint8_t b = 0; b < 9; b++)
+    {
+      out.write(bytes[b]);
+      check ^= bytes[b];
+    }
+  }
+
+  out.write(check);
+}
+
+void MinimalUltrasonic::clearTrace()
+{
+  _traceNext = 0;
+  _traceLength = 0;
+}
+#endif
+
 // ===========================
 // Private Methods
 // ===========================
 
-unsigned long MinimalUltrasonic::timing() const
+MinimalUltrasonic::Status MinimalUltrasonic::timing(unsigned long &duration, unsigned long maxWidth) const
 {
+  duration = 0;
+
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM
+  unsigned long triggerStart = micros();
+#elif MINIMAL_ULTRASONIC_TRACE
+  const unsigned long triggerStart = 0; // Only the histogram times the trigger
+#endif
+
   // For 3-pin sensors, we need to switch the pin mode
   if (_isThreePin)
   {
@@ -123,13 +954,20 @@ unsigned long MinimalUltrasonic::timing() const
     pinMode(_trigPin, INPUT);
   }
 
+  // Keep the limit in a local so the polling loops compare against a register
+  const unsigned long timeout = _timeout;
+
   // Wait for echo pin to go HIGH (start of pulse)
   unsigned long startWait = micros();
   while (!digitalRead(_echoPin))
   {
-    if ((micros() - startWait) > _timeout)
+    unsigned long waited = micros() - startWait;
+    if (waited > timeout)
     {
-      return 0; // Timeout - no echo received
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM || MINIMAL_ULTRASONIC_TRACE
+      recordEdges(NO_ECHO, triggerStart, startWait, waited, 0);
+#endif
+      return NO_ECHO; // Timeout - no echo received
     }
   }
 
@@ -137,24 +975,40 @@ unsigned long MinimalUltrasonic::timing() const
   unsigned long pulseStart = micros();
   while (digitalRead(_echoPin))
   {
-    if ((micros() - pulseStart) > _timeout)
+    unsigned long width = micros() - pulseStart;
+    if (width > maxWidth)
     {
-      return 0; // Timeout - echo too long
+      // Timeout - echo too long, or longer than the caller cares about
+      Status status = (maxWidth < timeout) ? OUT_OF_GATE : STUCK_HIGH;
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM || MINIMAL_ULTRASONIC_TRACE
+      recordEdges(status, triggerStart, startWait, pulseStart - startWait, width);
+#endif
+      return status;
     }
   }
   unsigned long pulseEnd = micros();
 
-  // Return the duration of the echo pulse
-  return pulseEnd - pulseStart;
+  // Report the duration of the echo pulse
+  duration = pulseEnd - pulseStart;
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM || MINIMAL_ULTRASONIC_TRACE
+  // Recorded after the fact so the bookkeeping does not delay the edges
+  recordEdges(OK, triggerStart, startWait, pulseStart - startWait, duration);
+#endif
+  return OK;
 }
 
-float MinimalUltrasonic::convertToUnit(unsigned long microseconds, Unit unit) const
+float MinimalUltrasonic::convertToUnit(unsigned long microseconds, Unit unit)
 {
   // First, calculate distance in centimeters
   // Distance = (Time / 2) / microseconds_per_cm
   // Division by 2 because sound travels to object and back
   float distanceCm = microseconds / MICROSECONDS_PER_CM / 2.0;
 
+  return convertFromCm(distanceCm, unit);
+}
+
+float MinimalUltrasonic::convertFromCm(float distanceCm, Unit unit)
+{
   // Convert to requested unit
   switch (unit)
   {
@@ -184,3 +1038,364 @@ float MinimalUltrasonic::convertToUnit(unsigned long microseconds, Unit unit) co
     return distanceCm;
   }
 }
+
+uint32_t MinimalUltrasonic::toMicrometers(unsigned long microseconds)
+{
+  // Beyond ~25 s of flight the result no longer fits in 32 bits
+  if (microseconds > 0xFFFFFFFFUL / (MICROMETERS_PER_US_INT + 1))
+  {
+    return 0xFFFFFFFFUL;
+  }
+
+  // microseconds = high * 2^16 + low, so every partial product fits in 32 bits
+  uint32_t high = microseconds >> 16;
+  uint32_t low = microseconds & 0xFFFFUL;
+
+  // Fractional contributions that land below 1 µm, in Q16
+  uint32_t fraction = low * MICROMETERS_PER_US_FRAC_HI +
+                      high * MICROMETERS_PER_US_FRAC_LO +
+                      ((low * MICROMETERS_PER_US_FRAC_LO) >> 16);
+
+  return microseconds * MICROMETERS_PER_US_INT +
+         high * MICROMETERS_PER_US_FRAC_HI +
+         ((fraction + 0x8000UL) >> 16);
+}
+
+unsigned long MinimalUltrasonic::toMicroseconds(float distance, Unit unit)
+{
+  // Bring the distance to centimeters first (inverse of convertToUnit)
+  float distanceCm;
+  switch (unit)
+  {
+  case METERS:
+    distanceCm = distance * 100.0;
+    break;
+
+  case MM:
+    distanceCm = distance / 10.0;
+    break;
+
+  case INCHES:
+    distanceCm = distance * 2.54;
+    break;
+
+  case YARDS:
+    distanceCm = distance * 91.44;
+    break;
+
+  case MILES:
+    distanceCm = distance * 160934.4;
+    break;
+
+  case CM:
+  default:
+    distanceCm = distance;
+    break;
+  }
+
+  // Round trip: twice the distance at MICROSECONDS_PER_CM
+  float microseconds = distanceCm * 2.0 * MICROSECONDS_PER_CM;
+
+  if (!(microseconds > 0))
+  {
+    return 0;
+  }
+  if (microseconds >= 4294967040.0f)
+  {
+    return 0xFFFFFFFFUL;
+  }
+  return (unsigned long)(microseconds + 0.5f);
+}
+
+unsigned long MinimalUltrasonic::applyCalibration(unsigned long raw) const
+{
+  // Identity calibration: nothing to do
+  if (_calibration.offset == 0 && _calibration.gain == CALIBRATION_UNITY)
+  {
+    return raw;
+  }
+
+  if (raw > CALIBRATION_MAX_RAW)
+  {
+    raw = CALIBRATION_MAX_RAW;
+  }
+
+  // raw * gain split into integer and fractional parts so that every
+  // intermediate fits in 32 bits (raw < 2^16, gain < 2^17)
+  uint32_t whole = raw * (_calibration.gain >> 16);
+  uint32_t frac = raw * (_calibration.gain & 0xFFFFUL);
+
+  // Add the Q16 offset: integer part via arithmetic shift, fraction rounded
+  int32_t corrected = (int32_t)(whole + (frac >> 16)) + (_calibration.offset >> 16);
+  int32_t remainder = (int32_t)(frac & 0xFFFFUL) + (_calibration.offset & 0xFFFF) + 0x8000;
+  corrected += remainder >> 16;
+
+  return (corrected > 0) ? (unsigned long)corrected : 0;
+}
+
+unsigned long MinimalUltrasonic::removeCalibration(unsigned long corrected) const
+{
+  // Identity calibration: nothing to do
+  if (_calibration.offset == 0 && _calibration.gain == CALIBRATION_UNITY)
+  {
+    return corrected;
+  }
+
+  if (corrected > CALIBRATION_MAX_RAW)
+  {
+    corrected = CALIBRATION_MAX_RAW;
+  }
+
+  // raw = (corrected - offset) / gain, with the offset rounded down to whole
+  // microseconds and the gain halved so the shift stays within 32 bits;
+  // every rounding step errs towards a longer raw duration
+  int32_t shifted = (int32_t)corrected - (_calibration.offset >> 16);
+  if (shifted <= 0)
+  {
+    return 0;
+  }
+
+  uint32_t halfGain = _calibration.gain >> 1;
+  return (((uint32_t)shifted << 15) + halfGain - 1) / halfGain + 1;
+}
+
+uint16_t MinimalUltrasonic::applySmoothing(uint16_t duration) const
+{
+  // Seed with the first sample instead of ramping up from zero
+  if (_ema == 0)
+  {
+    _ema = (uint32_t)duration << _smoothing;
+    return duration;
+  }
+
+  // avg += (sample - avg) / 2^shift, with the average kept scaled by 2^shift
+  _ema -= _ema >> _smoothing;
+  _ema += duration;
+
+  return smoothedDuration();
+}
+
+uint16_t MinimalUltrasonic::smoothedDuration() const
+{
+  return (uint16_t)((_ema + (1UL << (_smoothing - 1))) >> _smoothing);
+}
+
+uint8_t MinimalUltrasonic::rate(Status status, uint16_t duration, unsigned long raw) const
+{
+  // Shift the outcome into the dropout history
+  _outcomes = (_outcomes << 1) | (status != OK);
+  if (status != OK)
+  {
+    return 0;
+  }
+
+  // Each factor scales the score down, with no division on the per-ping path
+  uint16_t score = 255;
+
+  // Dropout history: recent failures make this echo less trustworthy
+  uint8_t failures = 0;
+  for (uint8_t bits = _outcomes; bits != 0; bits &= bits - 1)
+  {
+    failures++;
+  }
+  score = (score * (uint16_t)(256 - failures * CONFIDENCE_DROPOUT_PENALTY)) >> 8;
+
+  uint16_t tolerance = (duration >> CONFIDENCE_TOLERANCE_SHIFT) + CONFIDENCE_TOLERANCE_US;
+  if (_recent == 0)
+  {
+    // Nothing to agree with yet
+    score = (score * CONFIDENCE_NO_HISTORY) >> 8;
+    _recent = duration;
+  }
+  else
+  {
+    // Agreement with recent samples: full marks within tolerance, then tolerance / deviation
+    uint16_t deviation = (duration > _recent) ? duration - _recent : _recent - duration;
+    score = scaleDown(score, tolerance, deviation);
+
+    // Stability: a jittery echo width lowers trust even when this sample agrees
+    score = scaleDown(score, tolerance, (uint32_t)tolerance + _jitter);
+
+    // Update both running averages with weight 1/4
+    _jitter = _jitter - (_jitter >> 2) + (deviation >> 2);
+    _recent = _recent - (_recent >> 2) + (duration >> 2);
+  }
+
+  // Range edge: echoes ending just before the timeout may have been cut
+  // short. The tracking gate and the adaptive timeout are left out: an echo
+  // right where they expect it is the best case, not a marginal one
+  unsigned long edge = _timeout >> CONFIDENCE_EDGE_SHIFT;
+  unsigned long margin = (raw < _timeout) ? _timeout - raw : 0;
+  score = scaleDown(score, margin, edge);
+
+  return (uint8_t)score;
+}
+
+void MinimalUltrasonic::adaptInterval(const Reading &reading) const
+{
+  bool urgent;
+
+  if (reading.ok())
+  {
+    // Something close, a target that (re)appeared, or one that moved since
+    // the previous valid reading: keep watching at full rate
+    uint16_t change = (reading.duration > _adaptiveLast) ? reading.duration - _adaptiveLast
+                                                         : _adaptiveLast - reading.duration;
+    urgent = reading.duration < _adaptiveAlert || _adaptiveLast == 0 || change > _adaptiveMotion;
+    _adaptiveLast = reading.duration;
+  }
+  else
+  {
+    // A target that was just there vanished: look again quickly
+    urgent = _adaptiveLast != 0;
+    _adaptiveLast = 0;
+  }
+
+  if (urgent)
+  {
+    _pingInterval = _adaptiveMin;
+    return;
+  }
+
+  // Quiet scene: back off by 1/8 per ping, at least 1 µs so 0 can grow
+  unsigned long step = (_pingInterval >> 3) + 1;
+  _pingInterval = (_adaptiveMax - _pingInterval > step) ? _pingInterval + step : _adaptiveMax;
+}
+
+void MinimalUltrasonic::track(const Reading &reading) const
+{
+  if (!reading.ok())
+  {
+    // Lost the target: look over the full range next time
+    _trackCount = 0;
+    return;
+  }
+
+  _trackCenter = reading.duration;
+  _trackCount = (_trackCount + 1 < _trackEvery) ? _trackCount + 1 : 0;
+}
+
+void MinimalUltrasonic::adaptTimeout(const Reading &reading, bool probe) const
+{
+  _probeCount = (_probeCount + 1 < _probeEvery) ? _probeCount + 1 : 0;
+
+  if (!reading.ok())
+  {
+    // A miss says nothing about how far the echoes are
+    return;
+  }
+
+  uint16_t duration = reading.duration;
+  uint16_t q = _timeoutQuantile;
+
+  // A probe that finds an echo beyond the estimate adopts it at once
+  if (q == 0 || (probe && duration > q))
+  {
+    _timeoutQuantile = duration;
+    return;
+  }
+
+  // Frugal streaming quantile: 15 steps up for 1 step down settles where
+  // 1 echo in 16 is longer than the estimate
+  uint16_t step = (q >> 8) + 1;
+  if (duration > q)
+  {
+    unsigned long up = (unsigned long)q + 15U * step;
+    _timeoutQuantile = (up > 0xFFFFUL) ? 0xFFFF : (uint16_t)up;
+  }
+  else if (duration < q)
+  {
+    _timeoutQuantile = (q > step) ? q - step : 1;
+  }
+}
+
+#if MINIMAL_ULTRASONIC_STATS
+void MinimalUltrasonic::count(Status status, bool shortened, unsigned long raw, unsigned long blocked) const
+{
+  _stats.pings++;
+
+  // About 71 minutes of pinging fill 32 bits: stop there instead of wrapping
+  uint32_t room = 0xFFFFFFFFUL - _stats.blockedMicros;
+  _stats.blockedMicros += (blocked < room) ? (uint32_t)blocked : room;
+
+  // Not a failure: the target is just beyond the limit
+  if (shortened)
+  {
+    _stats.beyondLimit++;
+    return;
+  }
+
+  switch (status)
+  {
+  case OK:
+  {
+    _stats.valid++;
+    uint16_t width = (raw > 0xFFFFUL) ? 0xFFFF : (uint16_t)raw;
+    if (width < _stats.minRaw)
+    {
+      _stats.minRaw = width;
+    }
+    if (width > _stats.maxRaw)
+    {
+      _stats.maxRaw = width;
+    }
+    break;
+  }
+
+  case NO_ECHO:
+    _stats.noEcho++;
+    break;
+
+  case STUCK_HIGH:
+    _stats.stuckHigh++;
+    break;
+
+  default:
+    _stats.outOfGate++;
+    break;
+  }
+}
+#endif
+
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM || MINIMAL_ULTRASONIC_TRACE
+void MinimalUltrasonic::recordEdges(Status status, unsigned long triggerStart, unsigned long start,
+                                    unsigned long rise, unsigned long width) const
+{
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM
+  addToHistogram(_histogram.trigger, start - triggerStart);
+  addToHistogram(_histogram.rise, rise);
+  if (status != NO_ECHO)
+  {
+    addToHistogram(_histogram.pulse, width);
+  }
+#endif
+
+#if MINIMAL_ULTRASONIC_TRACE
+  TraceEntry &entry = _trace[_traceNext];
+  entry.trigger = (uint32_t)start;
+  entry.rise = 0;
+  entry.fall = 0;
+  if (status != NO_ECHO)
+  {
+    entry.rise = (rise > 0xFFFFUL) ? 0xFFFF : (uint16_t)rise;
+  }
+  if (status == OK)
+  {
+    unsigned long fall = rise + width;
+    entry.fall = (fall > 0xFFFFUL) ? 0xFFFF : (uint16_t)fall;
+  }
+  entry.status = status;
+
+  _traceNext = (_traceNext + 1 < MINIMAL_ULTRASONIC_TRACE) ? _traceNext + 1 : 0;
+  if (_traceLength < MINIMAL_ULTRASONIC_TRACE)
+  {
+    _traceLength++;
+  }
+#else
+  (void)start;
+#endif
+#if !MINIMAL_ULTRASONIC_TIMING_HISTOGRAM
+  (void)triggerStart;
+#endif
+}
+#endif
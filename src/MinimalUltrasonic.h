@@ -31,6 +31,50 @@
 
 #include <Arduino.h>
 
+/**
+ * @brief Set to 1 to keep per-sensor ping statistics (see getStats())
+ *
+ * Changes the class layout, so it must be the same for every file that
+ * includes this header: pass it as a compiler flag (e.g. PlatformIO
+ * build_flags = -DMINIMAL_ULTRASONIC_STATS=1) rather than defining it in
+ * a sketch. When 0 (the default) the counters are not compiled at all.
+ */
+#ifndef MINIMAL_ULTRASONIC_STATS
+#define MINIMAL_ULTRASONIC_STATS 0
+#endif
+
+/**
+ * @brief Set to 1 to cache lastDistance() for every unit, not just the last one
+ *
+ * Same rules as MINIMAL_ULTRASONIC_STATS. By default lastDistance() keeps
+ * the value of the unit asked for last (5 bytes of RAM per sensor), which
+ * covers the usual single-unit loop. With 1, each unit is converted once
+ * per ping and kept (25 bytes), for sketches that alternate between units.
+ */
+#ifndef MINIMAL_ULTRASONIC_UNIT_CACHE
+#define MINIMAL_ULTRASONIC_UNIT_CACHE 0
+#endif
+
+/**
+ * @brief Set to 1 to keep a histogram of the time spent in each ping phase
+ *
+ * Same rules as MINIMAL_ULTRASONIC_STATS: a global compiler flag, not a
+ * sketch define. Costs 96 bytes of RAM per sensor when enabled.
+ */
+#ifndef MINIMAL_ULTRASONIC_TIMING_HISTOGRAM
+#define MINIMAL_ULTRASONIC_TIMING_HISTOGRAM 0
+#endif
+
+/**
+ * @brief Number of pings to keep edge times of (see dumpTrace()), 0 = off
+ *
+ * Same rules as MINIMAL_ULTRASONIC_STATS. Up to 255; each ping costs
+ * 9 bytes of RAM per sensor on AVR.
+ */
+#ifndef MINIMAL_ULTRASONIC_TRACE
+#define MINIMAL_ULTRASONIC_TRACE 0
+#endif
+
 /**
  * @class MinimalUltrasonic
  * @brief Main class for ultrasonic distance measurement
@@ -56,9 +100,213 @@ public:
     MILES = 5    ///< Miles
   };
 
+  /**
+   * @brief Number of entries in the Unit enum
+   */
+  static const uint8_t UNIT_COUNT = 6;
+
+  /**
+   * @brief Unit mask selecting every unit for readAll()
+   */
+  static const uint8_t ALL_UNITS = 0x3F;
+
+  /**
+   * @brief Bit for a unit in a readAll() unit mask
+   * @param unit Unit to select
+   * @return Mask with only that unit's bit set
+   *
+   * @example
+   * uint8_t units = MinimalUltrasonic::unitBit(MinimalUltrasonic::CM) |
+   *                 MinimalUltrasonic::unitBit(MinimalUltrasonic::INCHES);
+   */
+  static uint8_t unitBit(Unit unit) { return (uint8_t)(1 << unit); }
+
   // Backward compatibility with old defines
   static const uint8_t INC = INCHES;  ///< Legacy support for INC constant
 
+  /**
+   * @enum Status
+   * @brief Outcome of a single measurement
+   */
+  enum Status : uint8_t
+  {
+    OK = 0,           ///< Valid echo received
+    NO_ECHO = 1,      ///< Echo pin never went HIGH before the timeout
+    STUCK_HIGH = 2,   ///< Echo pin stayed HIGH past the timeout (no target or wiring fault)
+    OUT_OF_GATE = 3,  ///< Echo received but outside the accepted distance range (or past 65535 µs)
+    TOO_SOON = 4,     ///< Not pinged: the ping interval has not elapsed yet
+    NO_CONSENSUS = 5  ///< readRobust(): pings never agreed within the tolerance
+  };
+
+  /**
+   * @struct Distances
+   * @brief One distance per unit, all derived from the same echo
+   */
+  struct Distances
+  {
+    float value[UNIT_COUNT];  ///< Distance per unit, indexed by Unit (0 if not requested)
+
+    /**
+     * @brief Distance in the given unit
+     */
+    float operator[](Unit unit) const { return value[unit]; }
+  };
+
+  /**
+   * @struct Threshold
+   * @brief A distance pre-converted to echo duration for cheap comparisons
+   *
+   * Build it once (e.g. as a global) and compare readings against it in
+   * integer microseconds instead of converting every reading to float.
+   *
+   * @example
+   * const MinimalUltrasonic::Threshold obstacle(30);  // 30 cm
+   * if (sensor.closerThan(obstacle)) { brake(); }
+   */
+  struct Threshold
+  {
+    unsigned long duration;  ///< Round-trip time of the distance in microseconds
+
+    /**
+     * @brief Convert a distance into a threshold
+     * @param distance Distance in the given unit
+     * @param unit Unit of distance (default: CM)
+     */
+    Threshold(float distance, Unit unit = CM);
+  };
+
+  /**
+   * @struct Reading
+   * @brief Result of measure(): echo duration, timestamp and status
+   *
+   * Packed into 8 bytes so it is cheap to return and to keep in buffers.
+   * The distance is derived from the duration on demand. The confidence
+   * rates how trustworthy the echo is, for weighting sensors in fusion.
+   *
+   * @example
+   * MinimalUltrasonic::Reading r = sensor.measure();
+   * if (r.ok()) {
+   *   Serial.println(r.distance());
+   * } else if (r.status == MinimalUltrasonic::NO_ECHO) {
+   *   // Nothing answered: re-pinging right away will not help
+   * }
+   */
+  struct Reading
+  {
+    uint32_t timestamp;  ///< micros() when the ping was requested
+    uint16_t duration;   ///< Calibrated echo width in microseconds (saturates at 65535)
+    Status status;       ///< Outcome of the measurement
+    uint8_t confidence;  ///< Trust in the echo, 0 (none, or failed) to 255
+
+    /**
+     * @brief True if the reading holds a valid echo
+     */
+    bool ok() const { return status == OK; }
+
+    /**
+     * @brief Distance in the given unit, or 0 if the reading is not OK
+     * @param unit The unit of measurement (default: CM)
+     */
+    float distance(Unit unit = CM) const;
+
+    /**
+     * @brief Distance in micrometers, or 0 if the reading is not OK
+     */
+    uint32_t micrometers() const;
+
+    /**
+     * @brief True if the reading is OK and closer than the threshold
+     * @param threshold Distance threshold to compare against
+     */
+    bool closerThan(const Threshold &threshold) const { return ok() && duration < threshold.duration; }
+  };
+
+  /**
+   * @brief Q16 fixed-point representation of 1.0 (identity calibration gain)
+   */
+  static const uint32_t CALIBRATION_UNITY = 65536UL;
+
+  /**
+   * @struct Calibration
+   * @brief Per-sensor correction coefficients in Q16 fixed point
+   *
+   * Applied to the raw echo duration before any unit conversion:
+   * corrected = raw * gain + offset (both Q16, i.e. scaled by 65536).
+   * The struct is plain data so it can be written to and read back
+   * from EEPROM with EEPROM.put() / EEPROM.get().
+   *
+   * @example
+   * EEPROM.put(0, sensor.getCalibration());
+   * MinimalUltrasonic::Calibration stored;
+   * EEPROM.get(0, stored);
+   * sensor.setCalibration(stored);
+   */
+  struct Calibration
+  {
+    int32_t offset;  ///< Offset in Q16 microseconds (signed)
+    uint32_t gain;   ///< Gain in Q16 (CALIBRATION_UNITY = 1.0)
+  };
+
+#if MINIMAL_ULTRASONIC_STATS
+  /**
+   * @struct Stats
+   * @brief Per-sensor health counters, maintained with integer increments
+   */
+  struct Stats
+  {
+    uint32_t pings;          ///< Pings fired (TOO_SOON calls are not counted)
+    uint32_t valid;          ///< Pings with status OK
+    uint32_t noEcho;         ///< Pings that ended with NO_ECHO
+    uint32_t stuckHigh;      ///< Pings that ended with STUCK_HIGH
+    uint32_t outOfGate;      ///< Echoes rejected by the minimum distance or the tracking gate
+    uint32_t beyondLimit;    ///< Pings stopped early at a threshold, the tracking gate or the adaptive timeout
+    uint16_t minRaw;         ///< Shortest raw echo of a valid ping in µs (0xFFFF until one)
+    uint16_t maxRaw;         ///< Longest raw echo of a valid ping in µs
+    uint32_t blockedMicros;  ///< Total time spent pinging, in µs (stops at 0xFFFFFFFF, ~71 min)
+  };
+#endif
+
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM
+  /**
+   * @brief Number of log2 buckets per phase
+   * Bucket 0 counts 0 µs, bucket b counts 2^(b-1) to 2^b - 1 µs, and the
+   * last bucket everything from 16384 µs up.
+   */
+  static const uint8_t HISTOGRAM_BUCKETS = 16;
+
+  /**
+   * @struct TimingHistogram
+   * @brief How long each phase of the pings took, in log2 buckets
+   *
+   * A phase that times out is counted with the time it took, so a timeout
+   * set too long shows up as a peak in the rise or pulse row. Counters stop
+   * at 65535.
+   */
+  struct TimingHistogram
+  {
+    uint16_t trigger[HISTOGRAM_BUCKETS]; ///< Trigger pulse, including pin mode switching
+    uint16_t rise[HISTOGRAM_BUCKETS];    ///< Wait for the echo pin to go HIGH (or NO_ECHO)
+    uint16_t pulse[HISTOGRAM_BUCKETS];   ///< Echo pulse width (or STUCK_HIGH, OUT_OF_GATE)
+  };
+#endif
+
+#if MINIMAL_ULTRASONIC_TRACE
+  /**
+   * @struct TraceEntry
+   * @brief Edge times of one ping
+   *
+   * rise and fall are offsets from trigger, saturated at 65535; 0 means the
+   * edge was not seen before the ping gave up.
+   */
+  struct TraceEntry
+  {
+    uint32_t trigger;  ///< micros() at the end of the trigger pulse
+    uint16_t rise;     ///< Echo pin went HIGH, µs after trigger
+    uint16_t fall;     ///< Echo pin went LOW, µs after trigger
+    uint8_t status;    ///< Final Status of the ping
+  };
+#endif
+
   /**
    * @brief Constructor for 3-pin ultrasonic sensors (Ping, Seeed SEN136B5B)
    * @param sigPin Digital pin number for the signal (combined trigger/echo)
@@ -88,7 +336,9 @@ public:
    * 
    * This method triggers the sensor, waits for the echo, and calculates
    * the distance based on the time of flight. Returns 0 if no echo is
-   * received within the timeout period.
+   * received within the timeout period. If the ping interval
+   * (setPingInterval()) has not elapsed, no ping is fired and the
+   * distance of the last measurement is returned, as by lastDistance().
    * 
    * @example
    * float distCm = sensor.read();                      // Distance in cm
@@ -97,13 +347,165 @@ public:
    */
   float read(Unit unit = CM) const;
 
+  /**
+   * @brief Take one measurement and report why it failed, if it did
+   * @return Reading with echo duration, timestamp, status and confidence
+   *
+   * Unlike read(), which returns 0 for every kind of failure, the status
+   * tells apart a missing echo, an echo that never ended, an echo outside
+   * the configured distance range and a ping suppressed because the ping
+   * interval had not elapsed.
+   *
+   * @example
+   * MinimalUltrasonic::Reading r = sensor.measure();
+   * if (r.status == MinimalUltrasonic::TOO_SOON) {
+   *   // Try again later, the sensor has not been pinged
+   * }
+   */
+  Reading measure();
+
+  /**
+   * @brief Ping once and return the median of the last three valid echoes
+   * @param unit The unit of measurement (default: CM)
+   * @return Median distance in the specified unit, or 0 if this ping failed
+   *
+   * Like read(), returns the last measurement if the ping interval has not
+   * elapsed.
+   *
+   * The cheapest spike rejection available: only the two previous
+   * durations are kept, and the median is taken with a min/max network on
+   * integers (see median3()). A single spike never reaches the output: the
+   * median is taken on the unsmoothed echoes and only the median goes
+   * through setSmoothing(). lastReading() and lastDistance() report the
+   * median as well.
+   *
+   * @example
+   * float cm = sensor.readMedian3();
+   */
+  float readMedian3(Unit unit = CM);
+
+  /**
+   * @brief Like readMedian3(), returning the full Reading
+   * @return Reading whose duration is the median of the last three valid echoes
+   */
+  Reading measureMedian3();
+
+  /**
+   * @brief Ping until k echoes agree, up to a maximum number of pings
+   * @param k Number of echoes that must agree (1 to maxPings)
+   * @param tolerance Largest difference from the newest echo that still agrees
+   * @param maxPings Give up after this many pings (at most 16; 0 pings
+   *        nothing and returns NO_CONSENSUS, leaving lastReading() alone)
+   * @param pings Receives the number of pings actually fired
+   * @return Reading whose duration is the mean of the agreeing echoes, or
+   *         status NO_CONSENSUS with duration 0 and the timestamp of the
+   *         last ping if they never agreed (even when that ping failed)
+   *
+   * A clean scene needs only k pings, so the cost follows the noise
+   * instead of always paying for a fixed burst. Pings are spaced by at
+   * least 20 ms and honour setPingInterval(); this call blocks until done.
+   * Agreement is checked on the unsmoothed echoes; with setSmoothing()
+   * only the result enters the average. lastReading() and lastDistance()
+   * report the returned Reading as well.
+   *
+   * @example
+   * uint8_t used;
+   * MinimalUltrasonic::Reading r =
+   *     sensor.readRobust(2, MinimalUltrasonic::Threshold(1), 5, used);
+   */
+  Reading readRobust(uint8_t k, const Threshold &tolerance, uint8_t maxPings, uint8_t &pings);
+
+  /**
+   * @brief Like readRobust() above, without reporting the ping count
+   */
+  Reading readRobust(uint8_t k, const Threshold &tolerance, uint8_t maxPings = 5);
+
+  /**
+   * @brief Ping once and convert the echo to several units
+   * @param distances Receives the distance in every requested unit
+   * @param units Mask of units to compute (see unitBit(), default: ALL_UNITS)
+   * @return The underlying Reading; all distances are 0 if it is not OK
+   *         (including TOO_SOON, which leaves lastDistance() untouched)
+   *
+   * Every value describes the same instant and only one ping is fired,
+   * instead of one read() per unit.
+   *
+   * @example
+   * MinimalUltrasonic::Distances d;
+   * if (sensor.readAll(d).ok()) {
+   *   Serial.println(d[MinimalUltrasonic::CM]);
+   *   Serial.println(d[MinimalUltrasonic::INCHES]);
+   * }
+   */
+  Reading readAll(Distances &distances, uint8_t units = ALL_UNITS);
+
+  /**
+   * @brief Get the most recent measurement without pinging
+   * @return The last Reading (status TOO_SOON if the sensor was never pinged)
+   */
+  Reading lastReading() const;
+
+  /**
+   * @brief Distance of the most recent measurement, without pinging
+   * @param unit The unit of measurement (default: CM)
+   * @return Distance in the given unit, or 0 if the last measurement failed
+   *
+   * Several consumers of the same reading share one ping. The value is
+   * cached until the next ping for the unit asked for last, so repeated
+   * calls in one unit convert once; with MINIMAL_ULTRASONIC_UNIT_CACHE set
+   * to 1, every unit is cached.
+   *
+   * @example
+   * sensor.measure();
+   * float mm = sensor.lastDistance(MinimalUltrasonic::MM);         // control loop
+   * float in = sensor.lastDistance(MinimalUltrasonic::INCHES);     // display
+   */
+  float lastDistance(Unit unit = CM) const;
+
+  /**
+   * @brief Ping once and tell whether something is closer than a threshold
+   * @param threshold Distance threshold to compare against
+   * @return true if a valid echo arrived before the threshold distance
+   *
+   * The comparison is done on the integer echo duration, and the wait for
+   * the end of the echo is abandoned as soon as the threshold is exceeded,
+   * so a clear path costs only the threshold's time of flight rather than
+   * the full echo or timeout.
+   *
+   * If the ping interval (setPingInterval()) has not elapsed, no ping is
+   * fired and the answer comes from the last measurement (lastReading()):
+   * an obstacle seen by the previous ping is still reported.
+   *
+   * @example
+   * const MinimalUltrasonic::Threshold obstacle(30);
+   * if (sensor.closerThan(obstacle)) { brake(); }
+   */
+  bool closerThan(const Threshold &threshold);
+
+  /**
+   * @brief Read the distance as an integer number of micrometers
+   * @return Distance in micrometers, or 0 if timeout/error
+   *
+   * Like read(), returns the last measurement if the ping interval has not
+   * elapsed.
+   *
+   * Scaling is done entirely in 32-bit fixed point with round-to-nearest,
+   * so the result is exact to within 1 µm of the floating-point conversion
+   * used by read() and no resolution of the echo timing is lost.
+   *
+   * @example
+   * uint32_t um = sensor.readMicrometers();  // 1000000 = 1 m
+   */
+  uint32_t readMicrometers() const;
+
   /**
    * @brief Set the timeout for echo response
    * @param timeOut Maximum time to wait for echo in microseconds
    * 
    * Use this to adjust the maximum detectable range. Longer timeouts
    * allow for greater distances but may slow down readings if no object
-   * is detected.
+   * is detected. Echoes longer than 65535µs (~11m) do not fit in a
+   * Reading and report OUT_OF_GATE.
    * 
    * @example
    * sensor.setTimeout(40000UL);  // ~6.8m max range
@@ -122,6 +524,136 @@ public:
    */
   void setMaxDistance(unsigned int distance);
 
+  /**
+   * @brief Set maximum detection distance in any unit
+   * @param distance Maximum distance
+   * @param unit Unit of distance
+   *
+   * The timeout is computed once, rounded to whole microseconds and
+   * saturated instead of wrapping for very large distances.
+   *
+   * @example
+   * sensor.setMaxDistance(2.5, MinimalUltrasonic::METERS);
+   */
+  void setMaxDistance(float distance, Unit unit);
+
+  /**
+   * @brief Set minimum valid distance; closer echoes are rejected
+   * @param distance Minimum distance (0 disables the check)
+   * @param unit Unit of distance (default: CM)
+   *
+   * Echoes shorter than the corresponding round-trip time are treated
+   * as invalid and read() returns 0. Useful to reject ringing and
+   * crosstalk that arrive before the sensor's blind zone ends.
+   *
+   * @example
+   * sensor.setMinDistance(2);  // HC-SR04 blind zone
+   */
+  void setMinDistance(float distance, Unit unit = CM);
+
+  /**
+   * @brief Shrink the timeout to just past the echoes actually seen
+   * @param minimum Never wait less than this
+   * @param probeEvery Every this many pings, wait the full timeout (0 disables)
+   *
+   * A streaming estimate of the 94th percentile of valid echo durations
+   * is kept with one 16-bit word (frugal quantile: up 15 steps on a longer
+   * echo, down 1 step on a shorter one). Pings wait for that estimate plus
+   * 25%, clamped between minimum and the timeout set by setTimeout() or
+   * setMaxDistance(), so reads with no echo end early in small spaces.
+   * Pings cut short report OUT_OF_GATE. The periodic full-range probe
+   * lets the estimate grow again when the scene gets larger.
+   *
+   * @example
+   * sensor.setAdaptiveTimeout(MinimalUltrasonic::Threshold(30));
+   */
+  void setAdaptiveTimeout(const Threshold &minimum, uint8_t probeEvery = 16);
+
+  /**
+   * @brief Set the minimum time between two pings
+   * @param interval Minimum interval in microseconds (0 disables the check)
+   *
+   * Echoes of a previous ping can be mistaken for the next one if the
+   * sensor is fired too often. When set, measure() returns TOO_SOON
+   * without touching the hardware until the interval has elapsed.
+   *
+   * @example
+   * sensor.setPingInterval(60000UL);  // 60ms, as recommended for HC-SR04
+   */
+  void setPingInterval(unsigned long interval);
+
+  /**
+   * @brief Get the minimum time between two pings
+   * @return Ping interval in microseconds (the current one in adaptive mode)
+   */
+  unsigned long getPingInterval() const;
+
+  /**
+   * @brief Let the sensor choose its ping interval from target motion
+   * @param minInterval Shortest interval in microseconds (fastest rate)
+   * @param maxInterval Longest interval in microseconds (slowest rate)
+   * @param motion Change between consecutive readings that counts as motion
+   * @param alert Targets closer than this keep the fastest rate (default: none)
+   *
+   * After every ping the interval grows by 1/8 while readings are stable,
+   * and drops straight to minInterval when the distance changes by more
+   * than motion or the target is closer than alert. Call measure() as
+   * often as you like: it returns TOO_SOON until the chosen interval has
+   * elapsed. setPingInterval() turns adaptive mode off.
+   *
+   * @example
+   * sensor.setAdaptiveRate(20000UL, 500000UL,                 // 50 Hz .. 2 Hz
+   *                        MinimalUltrasonic::Threshold(2),   // 2 cm counts as motion
+   *                        MinimalUltrasonic::Threshold(50)); // full rate under 50 cm
+   */
+  void setAdaptiveRate(unsigned long minInterval, unsigned long maxInterval,
+                       const Threshold &motion, const Threshold &alert = Threshold(0));
+
+  /**
+   * @brief Current ping rate
+   * @return Pings per second allowed by the current interval (0 if unlimited)
+   */
+  uint16_t getPingRate() const;
+
+  /**
+   * @brief Only accept echoes near the previous distance (tracking mode)
+   * @param window Half-width of the accepted window around the last echo (0 disables)
+   * @param reacquireEvery Every this many pings, ping full-range again (default: 10)
+   *
+   * Once a target is found, the next echo is expected within window of
+   * the last one. The wait for the echo is abandoned as soon as it runs
+   * past the window, which shortens pings that miss, and echoes ending
+   * before the window are rejected as crosstalk. Both report OUT_OF_GATE
+   * and make the next ping full-range, as does every reacquireEvery-th
+   * ping, so a new or suddenly closer target is picked up within one ping.
+   *
+   * @example
+   * sensor.setTracking(MinimalUltrasonic::Threshold(10));  // +/- 10 cm
+   */
+  void setTracking(const Threshold &window, uint8_t reacquireEvery = 10);
+
+  /**
+   * @brief Enable exponential smoothing of the echo duration
+   * @param shift Smoothing strength: alpha = 1 / 2^shift (0 disables, max 15)
+   *
+   * Each valid reading updates a fixed-point moving average using only
+   * shifts and adds: avg += (sample - avg) / 2^shift. The filter works on
+   * the echo duration, so every unit and every read method returns the
+   * smoothed value. closerThan() compares the echo itself, so an obstacle
+   * that appears suddenly is reported on the first ping rather than once
+   * the average has caught up. Changing the setting restarts the average.
+   *
+   * @example
+   * sensor.setSmoothing(2);  // alpha = 1/4
+   */
+  void setSmoothing(uint8_t shift);
+
+  /**
+   * @brief Get the current smoothing shift
+   * @return Smoothing shift (0 if smoothing is disabled)
+   */
+  uint8_t getSmoothing() const;
+
   /**
    * @brief Get the current timeout value
    * @return Current timeout in microseconds
@@ -144,21 +676,239 @@ public:
    */
   void setUnit(Unit unit);
 
+  /**
+   * @brief Fit the calibration offset against a target at a known distance
+   * @param knownDistance Distance to the reference target
+   * @param samples Number of valid pings to average (default: 10)
+   * @param unit Unit of knownDistance (default: CM)
+   * @return Mean uncorrected echo duration in microseconds, or 0 if no valid echo
+   *
+   * Averages several raw pings and sets the offset so that the corrected
+   * duration matches the expected time of flight. The gain is kept, so a
+   * single call removes the constant offset of the module. To fit the gain
+   * as well, call this at two distances and pass both results to the
+   * two-point overload.
+   *
+   * @example
+   * sensor.calibrate(20.0);  // Target placed 20 cm away
+   */
+  unsigned long calibrate(float knownDistance, uint8_t samples = 10, Unit unit = CM);
+
+  /**
+   * @brief Fit gain and offset from two reference measurements
+   * @param distanceA Distance of the first reference target
+   * @param rawA Mean raw duration measured at distanceA (microseconds)
+   * @param distanceB Distance of the second reference target
+   * @param rawB Mean raw duration measured at distanceB (microseconds)
+   * @param unit Unit of both distances (default: CM)
+   * @return true if the fit produced a plausible calibration and was applied;
+   *         false (calibration unchanged) if the gain is outside 0.5..2.0 or
+   *         the offset does not fit in Q16
+   *
+   * @example
+   * unsigned long near = sensor.calibrate(20.0);   // Target at 20 cm
+   * unsigned long far = sensor.calibrate(150.0);   // Target at 150 cm
+   * sensor.calibrate(20.0, near, 150.0, far);
+   */
+  bool calibrate(float distanceA, unsigned long rawA, float distanceB, unsigned long rawB, Unit unit = CM);
+
+  /**
+   * @brief Get the current calibration coefficients
+   * @return Calibration struct suitable for storing in EEPROM
+   */
+  Calibration getCalibration() const;
+
+  /**
+   * @brief Load calibration coefficients (e.g. from EEPROM at boot)
+   * @param calibration Coefficients previously obtained from getCalibration()
+   * @return true if applied, false if the gain is outside 0.5..2.0
+   *
+   * Rejecting implausible gains means an erased EEPROM (all 0xFF) leaves
+   * the sensor uncalibrated instead of producing garbage readings.
+   */
+  bool setCalibration(const Calibration &calibration);
+
+  /**
+   * @brief Reset calibration to identity (no offset, unity gain)
+   */
+  void resetCalibration();
+
+#if MINIMAL_ULTRASONIC_STATS
+  /**
+   * @brief Counters since construction or the last resetStats()
+   *
+   * Only available when MINIMAL_ULTRASONIC_STATS is 1.
+   *
+   * @example
+   * const MinimalUltrasonic::Stats &s = sensor.getStats();
+   * Serial.println(s.valid * 100UL / s.pings);  // success rate in %
+   */
+  const Stats &getStats() const;
+
+  /**
+   * @brief Zero all counters
+   */
+  void resetStats();
+#endif
+
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM
+  /**
+   * @brief Phase timings since construction or the last resetTimingHistogram()
+   *
+   * Only available when MINIMAL_ULTRASONIC_TIMING_HISTOGRAM is 1.
+   */
+  const TimingHistogram &getTimingHistogram() const;
+
+  /**
+   * @brief Print the histogram as a tab-separated table
+   * @param out Where to print, e.g. Serial
+   *
+   * One row per bucket, labelled with its lower bound in µs, with one
+   * column per phase:
+   * @code
+   * us     trigger rise    pulse
+   * 0      0       0       0
+   * 1      0       0       0
+   * ...
+   * @endcode
+   */
+  void printTimingHistogram(Print &out) const;
+
+  /**
+   * @brief Zero all buckets
+   */
+  void resetTimingHistogram();
+#endif
+
+#if MINIMAL_ULTRASONIC_TRACE
+  /**
+   * @brief Number of pings in the trace, up to MINIMAL_ULTRASONIC_TRACE
+   */
+  uint8_t traceLength() const;
+
+  /**
+   * @brief One ping of the trace
+   * @param index 0 for the oldest ping kept, traceLength() - 1 for the newest
+   */
+  const TraceEntry &getTrace(uint8_t index) const;
+
+  /**
+   * @brief Write the trace in binary, oldest ping first
+   * @param out Where to write, e.g. Serial or an SD card File
+   *
+   * Format (little endian): the bytes 'M' 'U' 'T' 1, the number of pings,
+   * 9 bytes per ping (trigger: 4, rise: 2, fall: 2, status: 1), and the XOR
+   * of all previous bytes. extras/trace/decode_trace.py turns it into CSV.
+   */
+  void dumpTrace(Print &out) const;
+
+  /**
+   * @brief Forget all pings in the trace
+   */
+  void clearTrace();
+#endif
+
+  /**
+   * @brief Median of three durations, as used by measureMedian3()
+   * @return The middle value
+   *
+   * A min/max network of three integer comparisons, with no data-dependent
+   * swaps. Public so it can be benchmarked and reused on stored durations.
+   */
+  static uint16_t median3(uint16_t a, uint16_t b, uint16_t c)
+  {
+    return max2(min2(a, b), min2(max2(a, b), c));
+  }
+
+  /**
+   * @brief Convert a distance (or speed) in centimeters to the specified unit
+   * @param distanceCm Distance in centimeters
+   * @param unit Target unit of measurement
+   * @return Distance in the specified unit
+   *
+   * Used by the filters in MinimalUltrasonicFilters.h to report their
+   * estimates in any unit.
+   */
+  static float convertFromCm(float distanceCm, Unit unit);
+
 private:
+  // Members updated by every ping are mutable, so read() can stay const
   uint8_t _trigPin;              ///< Trigger pin number
   uint8_t _echoPin;              ///< Echo pin number
   bool _isThreePin;              ///< True if using 3-pin sensor configuration
+  mutable bool _hasPinged;       ///< True once _last holds a real ping
   unsigned long _timeout;        ///< Timeout in microseconds
+  unsigned long _minWidth;       ///< Shortest accepted echo in microseconds
+  mutable unsigned long _pingInterval; ///< Minimum time between pings in microseconds
+  unsigned long _adaptiveMin;    ///< Adaptive rate: shortest interval in microseconds
+  unsigned long _adaptiveMax;    ///< Adaptive rate: longest interval, 0 = adaptive mode off
+  uint16_t _adaptiveMotion;      ///< Adaptive rate: duration change that counts as motion
+  uint16_t _adaptiveAlert;       ///< Adaptive rate: durations below this keep the fastest rate
+  mutable uint16_t _adaptiveLast; ///< Adaptive rate: last valid duration, 0 = no target
+  uint16_t _trackWindow;         ///< Tracking: half-width of the echo window in µs, 0 = off
+  mutable uint16_t _trackCenter; ///< Tracking: last valid unsmoothed duration in µs
+  uint8_t _trackEvery;           ///< Tracking: pings between full-range reacquisitions
+  mutable uint8_t _trackCount;   ///< Tracking: pings since the last full-range ping, 0 = next is full
+  unsigned long _timeoutFloor;   ///< Adaptive timeout: lower bound in µs
+  mutable uint16_t _timeoutQuantile; ///< Adaptive timeout: high-percentile echo duration, 0 = none yet
+  uint8_t _probeEvery;           ///< Adaptive timeout: pings between full-timeout probes, 0 = off
+  mutable uint8_t _probeCount;   ///< Adaptive timeout: pings since the last probe, 0 = next is a probe
+  mutable Reading _last;         ///< Most recent measurement
   Unit _defaultUnit;             ///< Default unit for measurements
+  uint8_t _smoothing;            ///< EMA shift (alpha = 1 / 2^shift), 0 = off
+  mutable uint32_t _ema;         ///< EMA accumulator: duration * 2^shift, 0 = empty
+  uint16_t _history[2];          ///< Previous two valid durations for measureMedian3(), 0 = empty
+  mutable uint16_t _recent;      ///< Running average of recent valid durations, 0 = none yet
+  mutable uint16_t _jitter;      ///< Running average of |duration - _recent|
+  mutable uint8_t _outcomes;     ///< Last 8 pings, one bit each, 1 = failed
+  Calibration _calibration;      ///< Raw-domain correction coefficients
+#if MINIMAL_ULTRASONIC_UNIT_CACHE
+  mutable float _cache[UNIT_COUNT]; ///< Converted distances of _last, per unit
+  mutable uint8_t _cached;       ///< Bit per unit: _cache entry is valid
+#else
+  mutable float _cache[1];       ///< Converted distance of _last in one unit
+  mutable uint8_t _cached;       ///< Unit of _cache[0] plus one, 0 = empty
+#endif
+#if MINIMAL_ULTRASONIC_STATS
+  mutable Stats _stats;          ///< Health counters
+#endif
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM
+  mutable TimingHistogram _histogram; ///< Phase timings, updated by timing()
+#endif
+#if MINIMAL_ULTRASONIC_TRACE
+  mutable TraceEntry _trace[MINIMAL_ULTRASONIC_TRACE]; ///< Ring buffer of recent pings
+  mutable uint8_t _traceNext;    ///< Trace: slot the next ping is written to
+  mutable uint8_t _traceLength;  ///< Trace: pings kept so far
+#endif
 
   /**
    * @brief Perform the ultrasonic timing measurement
-   * @return Time in microseconds for the echo to return, or 0 on timeout
+   * @param duration Receives the raw echo width in microseconds (0 on failure)
+   * @param maxWidth Longest echo to wait for, in raw microseconds
+   * @return OK, NO_ECHO, STUCK_HIGH, or OUT_OF_GATE if the echo outlasted
+   *         a maxWidth shorter than the timeout
    * 
    * This method sends a trigger pulse and measures the time until the
    * echo is received. It handles both 3-pin and 4-pin configurations.
    */
-  unsigned long timing() const;
+  Status timing(unsigned long &duration, unsigned long maxWidth) const;
+
+  /**
+   * @brief Shared implementation of measure() and closerThan()
+   * @param maxWidth Longest raw echo to wait for in microseconds
+   * @return Reading with calibrated, unsmoothed duration and status
+   *
+   * Stores the reading, unsmoothed, as the last one; lastReading() applies
+   * the average when reporting it.
+   */
+  Reading ping(unsigned long maxWidth) const;
+
+  /**
+   * @brief Feed a reading through the exponential moving average
+   * @param reading Reading just taken and stored as the last one
+   * @return The reading with its duration smoothed, if it is OK
+   */
+  Reading smooth(Reading reading) const;
 
   /**
    * @brief Convert raw microseconds to the specified unit
@@ -169,7 +919,124 @@ private:
    * Uses the speed of sound (343 m/s at 20°C) to calculate distance.
    * Formula: distance = (time * speed_of_sound) / 2
    */
-  float convertToUnit(unsigned long microseconds, Unit unit) const;
+  static float convertToUnit(unsigned long microseconds, Unit unit);
+
+  /**
+   * @brief Convert a round-trip duration to micrometers in fixed point
+   * @param microseconds Time of flight in microseconds
+   * @return Distance in micrometers, saturated at 0xFFFFFFFF
+   */
+  static uint32_t toMicrometers(unsigned long microseconds);
+
+  /**
+   * @brief Convert a distance to its round-trip echo duration
+   * @param distance Distance in the given unit
+   * @param unit Unit of distance
+   * @return Round-trip time in microseconds, saturated to the unsigned long range
+   */
+  static unsigned long toMicroseconds(float distance, Unit unit);
+
+  /**
+   * @brief Apply the calibration coefficients to a raw echo duration
+   * @param raw Raw echo duration in microseconds
+   * @return Corrected duration in microseconds (never negative)
+   *
+   * Uses 32-bit arithmetic only. Raw durations are saturated at 65535 µs
+   * (~11 m) while calibrated, which is beyond the range of any supported sensor.
+   */
+  unsigned long applyCalibration(unsigned long raw) const;
+
+  /**
+   * @brief Feed a duration through the exponential moving average
+   * @param duration Calibrated echo duration in microseconds
+   * @return Smoothed duration in microseconds
+   */
+  uint16_t applySmoothing(uint16_t duration) const;
+
+  /**
+   * @brief Current value of the moving average in microseconds, rounded
+   */
+  uint16_t smoothedDuration() const;
+
+  /**
+   * @brief Update the tracking window after a ping
+   * @param reading The reading just taken, before smoothing
+   */
+  void track(const Reading &reading) const;
+
+  /**
+   * @brief Update the adaptive timeout estimate after a ping
+   * @param reading The reading just taken, before smoothing
+   * @param probe Whether the ping waited the full timeout
+   */
+  void adaptTimeout(const Reading &reading, bool probe) const;
+
+  /**
+   * @brief Choose the next ping interval in adaptive mode
+   * @param reading The reading just taken
+   *
+   * Only fed pings that ran to an echo or to the full timeout: a ping
+   * stopped at a limit says nothing about whether the target moved.
+   */
+  void adaptInterval(const Reading &reading) const;
+
+  /**
+   * @brief Rate a ping and update the history the rating is based on
+   * @param status Outcome of the ping
+   * @param duration Calibrated, unsmoothed echo duration in microseconds
+   * @param raw Uncalibrated echo duration in microseconds
+   * @return Confidence from 0 to 255 (0 for failed pings)
+   *
+   * Not called for pings stopped early by a threshold, the tracking gate or
+   * the adaptive timeout, so those do not count as dropouts.
+   */
+  uint8_t rate(Status status, uint16_t duration, unsigned long raw) const;
+
+#if MINIMAL_ULTRASONIC_STATS
+  /**
+   * @brief Count a ping in the statistics
+   * @param status Final status of the ping
+   * @param shortened Whether the ping stopped early at one of its limits
+   * @param raw Uncalibrated echo duration in microseconds
+   * @param blocked Time the ping took in microseconds
+   */
+  void count(Status status, bool shortened, unsigned long raw, unsigned long blocked) const;
+#endif
+
+#if MINIMAL_ULTRASONIC_TIMING_HISTOGRAM || MINIMAL_ULTRASONIC_TRACE
+  /**
+   * @brief Feed the timing histogram and the trace with the edges of a ping
+   *
+   * Called once the echo is over, so no bookkeeping runs between the
+   * trigger and the rising edge.
+   * @param status Outcome of timing()
+   * @param triggerStart micros() before the trigger pulse
+   * @param start micros() at the end of the trigger pulse
+   * @param rise Time waited for the echo, up to its rise or the timeout
+   * @param width Time the echo pin stayed HIGH, 0 if it never rose
+   */
+  void recordEdges(Status status, unsigned long triggerStart, unsigned long start,
+                   unsigned long rise, unsigned long width) const;
+#endif
+
+  /**
+   * @brief Minimum of two via a comparison mask (all ones when a < b)
+   */
+  static uint16_t min2(uint16_t a, uint16_t b) { return b ^ ((a ^ b) & -(uint16_t)(a < b)); }
+
+  /**
+   * @brief Maximum of two via a comparison mask (all ones when a < b)
+   */
+  static uint16_t max2(uint16_t a, uint16_t b) { return a ^ ((a ^ b) & -(uint16_t)(a < b)); }
+
+  /**
+   * @brief Inverse of applyCalibration(), rounded up
+   * @param corrected Calibrated duration in microseconds
+   * @return Raw duration that is at least as long as the one mapping to corrected
+   *
+   * Only used to bound the echo wait, so a few microseconds of slack are harmless.
+   */
+  unsigned long removeCalibration(unsigned long corrected) const;
 };
 
 // Legacy compatibility - Old defines for backward compatibility
@@ -0,0 +1,132 @@
+/*
+ * @file MinimalUltrasonicFilters.cpp
+ * @brief Implementation of the non-template MinimalUltrasonic filters
+ * @version 2.0.0
+ * @date 25 Oct 2025
+ * @author fermeridamagni (Magni Development)
+ *
+ * @license MIT License
+ */
+
+#include "MinimalUltrasonicFilters.h"
+
+// ===========================
+// Constants
+// ===========================
+
+/**
+ * @brief Initial velocity variance in (cm/s)^2
+ * Nothing is known about the velocity before the second reading; 100 cm/s
+ * (1 sigma) covers anything a ranging sensor can track.
+ */
+static const float KALMAN_INITIAL_VELOCITY_VARIANCE = 10000.0;
+
+// ===========================
+// UltrasonicKalmanFilter
+// ===========================
+
+UltrasonicKalmanFilter::UltrasonicKalmanFilter(float accelerationNoise, float measurementNoise)
+    : _distance(0),
+      _velocity(0),
+      _p00(0),
+      _p01(0),
+      _p11(0),
+      _q(accelerationNoise * accelerationNoise),
+      _r(measurementNoise * measurementNoise),
+      _timestamp(0),
+      _initialized(false)
+{
+}
+
+MinimalUltrasonic::Reading UltrasonicKalmanFilter::update(MinimalUltrasonic::Reading reading)
+{
+  // No ping happened, nothing to learn
+  if (reading.status == MinimalUltrasonic::TOO_SOON)
+  {
+    return reading;
+  }
+
+  if (!_initialized)
+  {
+    if (reading.ok())
+    {
+      // Seed with the first measurement, velocity unknown
+      _distance = reading.distance();
+      _velocity = 0;
+      _p00 = _r;
+      _p01 = 0;
+      _p11 = KALMAN_INITIAL_VELOCITY_VARIANCE;
+      _timestamp = reading.timestamp;
+      _initialized = true;
+    }
+    return reading;
+  }
+
+  predict(reading.timestamp);
+
+  // Dropout: prediction only
+  if (!reading.ok())
+  {
+    return reading;
+  }
+
+  // Measurement update with H = [1 0]
+  float innovation = reading.distance() - _distance;
+  float s = _p00 + _r;
+  float k0 = _p00 / s;
+  float k1 = _p01 / s;
+
+  _distance += k0 * innovation;
+  _velocity += k1 * innovation;
+
+  // P = (I - K H) P, using the pre-update P01 for every term
+  float p01 = _p01;
+  _p11 -= k1 * p01;
+  _p01 = (1 - k0) * p01;
+  _p00 = (1 - k0) * _p00;
+
+  // Report the filtered distance as an echo duration
+  unsigned long duration = MinimalUltrasonic::Threshold(_distance).duration;
+  reading.duration = (duration > 0xFFFFUL) ? 0xFFFF : (uint16_t)duration;
+  return reading;
+}
+
+float UltrasonicKalmanFilter::distance(MinimalUltrasonic::Unit unit) const
+{
+  return MinimalUltrasonic::convertFromCm(_distance, unit);
+}
+
+float UltrasonicKalmanFilter::velocity(MinimalUltrasonic::Unit unit) const
+{
+  return MinimalUltrasonic::convertFromCm(_velocity, unit);
+}
+
+float UltrasonicKalmanFilter::covariance(uint8_t row, uint8_t col) const
+{
+  if (row == 0 && col == 0)
+  {
+    return _p00;
+  }
+  if (row == 1 && col == 1)
+  {
+    return _p11;
+  }
+  return _p01;
+}
+
+void UltrasonicKalmanFilter::predict(uint32_t timestamp)
+{
+  float dt = (timestamp - _timestamp) / 1000000.0;
+  _timestamp = timestamp;
+
+  // x = F x with F = [1 dt; 0 1]
+  _distance += _velocity * dt;
+
+  // P = F P F' + Q, Q from white-noise acceleration:
+  // Q = q * [dt^4/4 dt^3/2; dt^3/2 dt^2]
+  float dt2 = dt * dt;
+  float qdt2 = _q * dt2;
+  _p00 += dt * (2 * _p01 + dt * _p11) + qdt2 * dt2 / 4;
+  _p01 += dt * _p11 + qdt2 * dt / 2;
+  _p11 += qdt2;
+}
@@ -0,0 +1,618 @@
+/*
+ * @file MinimalUltrasonicFilters.h
+ * @brief Streaming filters for MinimalUltrasonic readings
+ * @version 2.0.0
+ * @date 25 Oct 2025
+ * @author fermeridamagni (Magni Development)
+ *
+ * @details Optional filters that take one MinimalUltrasonic::Reading per ping
+ *          and return a filtered Reading, so a filtered value is available
+ *          at the full ping rate instead of after a burst of pings.
+ *          Filters work on the integer echo duration, so they compose with
+ *          any unit conversion, and keep all state in fixed-size members
+ *          (no dynamic allocation). They are independent objects: only the
+ *          sensors that use a filter pay for its memory.
+ *
+ * @license MIT License
+ *
+ * @example
+ * MinimalUltrasonic sensor(12, 13);
+ * UltrasonicMedianFilter<5> median;
+ *
+ * void loop() {
+ *   MinimalUltrasonic::Reading r = median.update(sensor.measure());
+ *   if (r.ok()) Serial.println(r.distance());
+ * }
+ */
+
+#ifndef MinimalUltrasonicFilters_h
+#define MinimalUltrasonicFilters_h
+
+#include "MinimalUltrasonic.h"
+
+/**
+ * @class UltrasonicMedianFilter
+ * @brief Streaming median over the last K valid echo durations
+ * @tparam K Window size (1-255; odd sizes give a true median)
+ *
+ * Keeps a ring buffer in arrival order and a sorted copy of the same
+ * window. Each update removes the oldest sample from the sorted copy and
+ * inserts the new one, both by shifting, so an update costs O(K) and no
+ * re-sorting or re-pinging is needed.
+ */
+template <uint8_t K>
+class UltrasonicMedianFilter
+{
+  static_assert(K >= 1, "Median window needs at least 1 sample");
+
+public:
+  UltrasonicMedianFilter() { reset(); }
+
+  /**
+   * @brief Add a reading to the window
+   * @param reading Reading from MinimalUltrasonic::measure()
+   * @return The reading with its duration replaced by the window median,
+   *         or the reading unchanged if it is not OK
+   *
+   * Failed readings do not enter the window; value() keeps returning the
+   * median of the valid samples seen so far.
+   */
+  MinimalUltrasonic::Reading update(MinimalUltrasonic::Reading reading)
+  {
+    if (!reading.ok())
+    {
+      return reading;
+    }
+
+    uint8_t size = _count;
+    if (_count == K)
+    {
+      // Window full: drop the oldest sample from the sorted copy
+      remove(_ring[_head]);
+      size--;
+    }
+    else
+    {
+      _count++;
+    }
+
+    _ring[_head] = reading.duration;
+    _head = (_head + 1) % K;
+    insert(reading.duration, size);
+
+    reading.duration = value();
+    return reading;
+  }
+
+  /**
+   * @brief Current median echo duration in microseconds (0 if empty)
+   */
+  uint16_t value() const { return _count ? _sorted[_count / 2] : 0; }
+
+  /**
+   * @brief Current median distance in the given unit (0 if empty)
+   * @param unit The unit of measurement (default: CM)
+   */
+  float distance(MinimalUltrasonic::Unit unit = MinimalUltrasonic::CM) const
+  {
+    MinimalUltrasonic::Reading median = {0, value(), _count ? MinimalUltrasonic::OK : MinimalUltrasonic::NO_ECHO, 0};
+    return median.distance(unit);
+  }
+
+  /**
+   * @brief Number of samples currently in the window (0 to K)
+   */
+  uint8_t count() const { return _count; }
+
+  /**
+   * @brief Sample of a given rank in the window
+   * @param rank 0 for the smallest sample, count() - 1 for the largest
+   * @return Echo duration in microseconds
+   */
+  uint16_t sorted(uint8_t rank) const { return _sorted[rank]; }
+
+  /**
+   * @brief Empty the window
+   */
+  void reset()
+  {
+    _head = 0;
+    _count = 0;
+  }
+
+private:
+  uint16_t _ring[K];    ///< Samples in arrival order
+  uint16_t _sorted[K];  ///< The same samples in ascending order
+  uint8_t _head;        ///< Next ring slot to write (oldest sample when full)
+  uint8_t _count;       ///< Number of valid samples
+
+  /**
+   * @brief Remove one occurrence of value from the full sorted window
+   */
+  void remove(uint16_t value)
+  {
+    uint8_t i = 0;
+    while (i < K - 1 && _sorted[i] != value)
+    {
+      i++;
+    }
+    for (; i < K - 1; i++)
+    {
+      _sorted[i] = _sorted[i + 1];
+    }
+  }
+
+  /**
+   * @brief Insert value into the first size entries of the sorted window
+   */
+  void insert(uint16_t value, uint8_t size)
+  {
+    uint8_t i = size;
+    while (i > 0 && _sorted[i - 1] > value)
+    {
+      _sorted[i] = _sorted[i - 1];
+      i--;
+    }
+    _sorted[i] = value;
+  }
+};
+
+/**
+ * @class UltrasonicHampelFilter
+ * @brief Streaming Hampel outlier rejection over the last K valid pings
+ * @tparam K Window size (odd, at least 3)
+ *
+ * A sample is an outlier when it lies further from the window median than
+ * threshold times the scaled median absolute deviation (MAD * 1.4826, the
+ * MAD's estimate of one standard deviation). Outliers are replaced by the
+ * median; other samples pass through unchanged, so unlike a mean or
+ * median filter the signal is not smoothed when nothing is wrong.
+ *
+ * The window is kept sorted incrementally (see UltrasonicMedianFilter),
+ * and the MAD is found by merging the deviations on both sides of the
+ * median, so an update costs O(K) integer operations.
+ *
+ * @example
+ * UltrasonicHampelFilter<7> hampel;
+ * MinimalUltrasonic::Reading r = hampel.update(sensor.measure());
+ * Serial.println(hampel.rejected());
+ */
+template <uint8_t K>
+class UltrasonicHampelFilter
+{
+  static_assert(K >= 3, "Hampel window needs at least 3 samples");
+
+public:
+  /**
+   * @brief Create a filter
+   * @param threshold Outlier threshold in scaled MADs (default: 3)
+   * @param minDeviation Deviations up to this many microseconds are never
+   *        outliers (default: 30, about 0.5 cm), so a window of identical
+   *        samples (MAD = 0) does not flag ordinary jitter
+   */
+  UltrasonicHampelFilter(uint8_t threshold = 3, uint16_t minDeviation = 30)
+      : _threshold(threshold), _minDeviation(minDeviation), _outlier(false), _total(0), _rejected(0)
+  {
+  }
+
+  /**
+   * @brief Check a reading and replace it by the median if it is an outlier
+   * @param reading Reading from MinimalUltrasonic::measure()
+   * @return The reading, with its duration replaced by the window median
+   *         if it was rejected; failed readings are returned unchanged
+   */
+  MinimalUltrasonic::Reading update(MinimalUltrasonic::Reading reading)
+  {
+    _outlier = false;
+    if (!reading.ok())
+    {
+      return reading;
+    }
+
+    // The raw sample always enters the window, replaced or not
+    uint16_t sample = reading.duration;
+    uint16_t median = _window.update(reading).duration;
+    _total++;
+
+    uint8_t count = _window.count();
+    if (count < 3)
+    {
+      return reading;
+    }
+
+    uint16_t deviation = (sample > median) ? sample - median : median - sample;
+    if (deviation <= _minDeviation)
+    {
+      return reading;
+    }
+
+    // threshold * 1.4826 * MAD, with 1.4826 ~ 95 / 64
+    uint32_t limit = ((uint32_t)mad(count, median) * _threshold * 95) >> 6;
+    if (deviation > limit)
+    {
+      _outlier = true;
+      _rejected++;
+      reading.duration = median;
+    }
+
+    return reading;
+  }
+
+  /**
+   * @brief True if the last update replaced an outlier
+   */
+  bool wasOutlier() const { return _outlier; }
+
+  /**
+   * @brief Number of valid samples checked since the last counter reset
+   */
+  uint32_t total() const { return _total; }
+
+  /**
+   * @brief Number of samples rejected as outliers since the last counter reset
+   */
+  uint32_t rejected() const { return _rejected; }
+
+  /**
+   * @brief Zero the total and rejected counters
+   */
+  void resetCounters()
+  {
+    _total = 0;
+    _rejected = 0;
+  }
+
+  /**
+   * @brief Empty the window and zero the counters
+   */
+  void reset()
+  {
+    _window.reset();
+    _outlier = false;
+    resetCounters();
+  }
+
+private:
+  UltrasonicMedianFilter<K> _window;  ///< Sorted window of raw samples
+  uint8_t _threshold;                 ///< Threshold in scaled MADs
+  uint16_t _minDeviation;             ///< Deviation floor in microseconds
+  bool _outlier;                      ///< Last update was an outlier
+  uint32_t _total;                    ///< Samples checked
+  uint32_t _rejected;                 ///< Samples rejected
+
+  /**
+   * @brief Median absolute deviation of the window
+   *
+   * Deviations grow moving outwards from the median on either side, so
+   * the two sides are already sorted; merging them until the middle
+   * element gives the median deviation without sorting.
+   */
+  uint16_t mad(uint8_t count, uint16_t median) const
+  {
+    int8_t left = count / 2 - 1;
+    uint8_t right = count / 2 + 1;
+    uint16_t deviation = 0;
+
+    // The median itself is deviation 0, the first of the merged sequence
+    for (uint8_t taken = 1; taken <= count / 2; taken++)
+    {
+      bool useLeft = right >= count ||
+                     (left >= 0 && median - _window.sorted(left) <= _window.sorted(right) - median);
+      if (useLeft)
+      {
+        deviation = median - _window.sorted(left--);
+      }
+      else
+      {
+        deviation = _window.sorted(right++) - median;
+      }
+    }
+
+    return deviation;
+  }
+};
+
+/**
+ * @class UltrasonicKalmanFilter
+ * @brief Constant-velocity Kalman filter: smoothed distance and closing speed
+ *
+ * Tracks distance and velocity (2 states) in centimeters and centimeters
+ * per second, in single precision with fixed-size state. The time step
+ * is taken from the reading timestamps, so irregular ping rates are
+ * handled correctly. Failed pings advance the prediction without a
+ * measurement update, so the estimate coasts through dropouts while its
+ * covariance grows.
+ *
+ * @example
+ * UltrasonicKalmanFilter kalman;
+ * kalman.update(sensor.measure());
+ * float d = kalman.distance();   // cm
+ * float v = kalman.velocity();   // cm/s, negative when approaching
+ */
+class UltrasonicKalmanFilter
+{
+public:
+  /**
+   * @brief Create a filter
+   * @param accelerationNoise Expected target acceleration (1 sigma) in cm/s^2 (default: 50)
+   * @param measurementNoise Measurement noise (1 sigma) in cm (default: 1)
+   *
+   * Larger accelerationNoise follows manoeuvres faster; larger
+   * measurementNoise smooths more.
+   */
+  UltrasonicKalmanFilter(float accelerationNoise = 50.0, float measurementNoise = 1.0);
+
+  /**
+   * @brief Advance the filter with a new reading
+   * @param reading Reading from MinimalUltrasonic::measure()
+   * @return For OK readings, the reading with its duration replaced by the
+   *         filtered distance; other readings unchanged
+   *
+   * Readings with status TOO_SOON are ignored (no ping happened). Other
+   * failures only run the prediction step up to the reading's timestamp.
+   */
+  MinimalUltrasonic::Reading update(MinimalUltrasonic::Reading reading);
+
+  /**
+   * @brief Estimated distance
+   * @param unit The unit of measurement (default: CM)
+   */
+  float distance(MinimalUltrasonic::Unit unit = MinimalUltrasonic::CM) const;
+
+  /**
+   * @brief Estimated rate of change of the distance, per second
+   * @param unit The unit of measurement (default: CM, i.e. cm/s)
+   * @return Positive when the target moves away, negative when approaching
+   */
+  float velocity(MinimalUltrasonic::Unit unit = MinimalUltrasonic::CM) const;
+
+  /**
+   * @brief Element of the 2x2 state covariance
+   * @param row 0 = distance, 1 = velocity
+   * @param col 0 = distance, 1 = velocity
+   * @return Covariance in cm^2, cm^2/s or cm^2/s^2
+   */
+  float covariance(uint8_t row, uint8_t col) const;
+
+  /**
+   * @brief True once the filter has received its first valid reading
+   */
+  bool initialized() const { return _initialized; }
+
+  /**
+   * @brief Forget the current estimate
+   */
+  void reset() { _initialized = false; }
+
+private:
+  float _distance;        ///< Distance estimate (cm)
+  float _velocity;        ///< Velocity estimate (cm/s)
+  float _p00;             ///< Distance variance
+  float _p01;             ///< Distance/velocity covariance
+  float _p11;             ///< Velocity variance
+  float _q;               ///< Acceleration variance (cm^2/s^4)
+  float _r;               ///< Measurement variance (cm^2)
+  uint32_t _timestamp;    ///< Timestamp of the last prediction (micros)
+  bool _initialized;      ///< True once seeded with a valid reading
+
+  /**
+   * @brief Propagate state and covariance to a timestamp
+   */
+  void predict(uint32_t timestamp);
+};
+
+/**
+ * @class UltrasonicCollisionEstimator
+ * @brief Closing speed and time-to-collision from the last N valid pings
+ * @tparam N Regression window (2-16 samples)
+ *
+ * Fits a least-squares line to echo duration against reading timestamp
+ * over the window, in 32-bit integer arithmetic (no 64-bit multiply or
+ * divide, which are slow library calls on AVR). The slope gives the closing
+ * speed, and the latest distance divided by that speed gives the time to
+ * collision. Fitting several samples is far less sensitive to noise
+ * than differencing two consecutive readings.
+ *
+ * Samples further apart than maxGap (default 1 s) restart the window,
+ * since a stale history says nothing about the current motion. Keep
+ * maxGap above the longest ping interval, e.g. twice the maxInterval
+ * given to MinimalUltrasonic::setAdaptiveRate(), or a slow-rate sensor
+ * never fills the window.
+ *
+ * @example
+ * UltrasonicCollisionEstimator<6> ttc;
+ * ttc.update(sensor.measure());
+ * if (ttc.timeToCollision() < 800) { brake(); }
+ */
+template <uint8_t N>
+class UltrasonicCollisionEstimator
+{
+  static_assert(N >= 2 && N <= 16, "Regression window must hold 2 to 16 samples");
+
+public:
+  /**
+   * @brief timeToCollision() value when the target is not approaching
+   */
+  static const uint32_t NO_COLLISION = 0xFFFFFFFFUL;
+
+  /**
+   * @brief Create an estimator
+   * @param maxGap Longest time between two samples in microseconds before
+   *        the window restarts (default: 1000000, 1 s)
+   */
+  UltrasonicCollisionEstimator(unsigned long maxGap = 1000000UL) : _maxGap(maxGap >> 6) { reset(); }
+
+  /**
+   * @brief Add a reading and refit the closing speed
+   * @param reading Reading from MinimalUltrasonic::measure()
+   * @return The reading, unchanged
+   *
+   * Failed readings are skipped.
+   */
+  MinimalUltrasonic::Reading update(MinimalUltrasonic::Reading reading)
+  {
+    if (!reading.ok())
+    {
+      return reading;
+    }
+
+    // Time in 64 µs ticks; 26 bits, since the 32-bit timestamp wraps
+    uint32_t tick = reading.timestamp >> 6;
+    if (_count != 0 && ((tick - _ticks[(_head + N - 1) % N]) & TICK_MASK) > _maxGap)
+    {
+      reset();
+    }
+
+    _ticks[_head] = tick;
+    _durations[_head] = reading.duration;
+    _head = (_head + 1) % N;
+    if (_count < N)
+    {
+      _count++;
+    }
+
+    fit(reading.duration);
+    return reading;
+  }
+
+  /**
+   * @brief Closing speed in millimeters per second
+   * @return Positive when approaching, negative when moving away, 0 until
+   *         two samples are known
+   */
+  int32_t closingSpeed() const
+  {
+    // Echo microseconds per second to mm/s: 1 mm is 5.82 µs of round trip.
+    // Rounded on the magnitude, as division truncates towards zero
+    if (_rate < 0)
+    {
+      return -((-_rate * 50 + 145) / 291);
+    }
+    return (_rate * 50 + 145) / 291;
+  }
+
+  /**
+   * @brief Time until the distance reaches zero at the current closing speed
+   * @return Milliseconds, or NO_COLLISION if the target is not approaching
+   */
+  uint32_t timeToCollision() const { return _ttc; }
+
+  /**
+   * @brief Number of samples in the regression window
+   */
+  uint8_t count() const { return _count; }
+
+  /**
+   * @brief Empty the window
+   */
+  void reset()
+  {
+    _head = 0;
+    _count = 0;
+    _rate = 0;
+    _ttc = NO_COLLISION;
+  }
+
+private:
+  static const uint32_t TICK_MASK = 0x03FFFFFFUL;       ///< Range of a tick (timestamp >> 6)
+  static const int32_t MAX_TIME = 2047;                 ///< Largest centered time in the fit
+  static const int32_t MAX_SXY = 0x7FFFFFFFL / 15625;   ///< Largest sxy that can be scaled to seconds
+  static const int32_t MAX_RATE = 40000000L;            ///< Keeps closingSpeed() within 32 bits
+
+  uint32_t _ticks[N];       ///< Sample times in 64 µs ticks
+  uint32_t _maxGap;         ///< Gap that restarts the window, in 64 µs ticks
+  uint16_t _durations[N];   ///< Echo durations in microseconds
+  uint8_t _head;            ///< Next slot to write
+  uint8_t _count;           ///< Samples in the window
+  int32_t _rate;            ///< Closing rate in echo microseconds per second
+  uint32_t _ttc;            ///< Time to collision in milliseconds
+
+  /**
+   * @brief Age of a sample in ticks, relative to the newest one
+   */
+  uint32_t age(uint8_t index, uint32_t newest) const
+  {
+    return (newest - _ticks[index]) & TICK_MASK;
+  }
+
+  /**
+   * @brief Least-squares slope of duration over time, then closing rate and TTC
+   * @param latest Most recent echo duration in microseconds
+   *
+   * Times are coarsened by a power of two until the window spans at most
+   * MAX_TIME units and centered on their rounded mean; durations are taken
+   * relative to the latest one. With at most 16 samples and 16-bit
+   * durations, every product and sum then fits in 32 bits.
+   */
+  void fit(uint16_t latest)
+  {
+    if (_count < 2)
+    {
+      return;
+    }
+
+    uint32_t newest = _ticks[(_head + N - 1) % N];
+    uint32_t span = 0;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+      if (age(i, newest) > span)
+      {
+        span = age(i, newest);
+      }
+    }
+
+    uint8_t shift = 0;
+    while ((span >> shift) > (uint32_t)MAX_TIME)
+    {
+      shift++;
+    }
+
+    int32_t sumAge = 0;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+      sumAge += (int32_t)(age(i, newest) >> shift);
+    }
+    int32_t meanAge = (sumAge + _count / 2) / _count;
+
+    int32_t sxy = 0;
+    int32_t sxx = 0;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+      int32_t time = meanAge - (int32_t)(age(i, newest) >> shift);
+      int32_t change = (int32_t)_durations[i] - latest;
+      sxy += time * change;
+      sxx += time * time;
+    }
+
+    // Scale both down until sxy * 15625 fits; the ratio is what matters
+    while (sxy > MAX_SXY || sxy < -MAX_SXY)
+    {
+      sxy /= 2;
+      sxx /= 2;
+    }
+    if (sxx == 0)
+    {
+      return;
+    }
+
+    // Slope is sxy / sxx echo µs per 2^shift ticks; 15625 ticks per second;
+    // closing means the duration is falling
+    _rate = -(sxy * 15625L) / sxx / (1L << shift);
+    if (_rate > MAX_RATE)
+    {
+      _rate = MAX_RATE;
+    }
+    else if (_rate < -MAX_RATE)
+    {
+      _rate = -MAX_RATE;
+    }
+
+    // TTC = distance / speed = latest µs / (rate µs per s), in ms
+    _ttc = (_rate > 0) ? (uint32_t)(((uint32_t)latest * 1000UL) / (uint32_t)_rate) : NO_COLLISION;
+  }
+};
+
+template <uint8_t N>
+const uint32_t UltrasonicCollisionEstimator<N>::NO_COLLISION;
+
+#endif // MinimalUltrasonicFilters_h